@@ -9,9 +9,7 @@ import sys
 from align4d import align4d
 
 
-def align(hypothesis: str | list[str], reference: list[list], partial_bound: int = 2, segment_length: int = None,
-          barrier_length: int = None, strip_punctuation: bool = True) -> dict:
-    # pre-processing
+def preprocess_input(hypothesis: str | list[str], reference: list[list], strip_punctuation: bool = True) -> tuple:
     if type(hypothesis) == str:
         hypothesis_temp = hypothesis.split()
     else:
@@ -40,23 +38,11 @@ def align(hypothesis: str | list[str], reference: list[list], partial_bound: int
     else:
         hypothesis_strip = hypothesis_temp
         reference_strip = reference_temp
+    return hypothesis_temp, reference_temp, reference_label, hypothesis_strip, reference_strip
 
-    # align
-    if (segment_length is None and barrier_length is not None) or (barrier_length is None and segment_length is not None):
-        raise Exception("Segment length or barrier length parameter incorrect or missing.")
-    if segment_length is None and barrier_length is None:
-        if len(hypothesis) < 100:
-            align_result = align4d.align_without_segment(hypothesis_strip, reference_strip, reference_label, partial_bound)
-        else:
-            align_result = align4d.align_with_auto_segment(hypothesis_strip, reference_strip, reference_label, partial_bound)
-    elif segment_length <= 0 and barrier_length <= 0:
-        align_result = align4d.align_without_segment(hypothesis_strip, reference_strip, reference_label, partial_bound)
-    elif segment_length > 0 and barrier_length > 0:
-        align_result = align4d.align_with_manual_segment(hypothesis_strip, reference_strip, reference_label, segment_length, barrier_length, partial_bound)
-    else:
-        raise Exception("Segment length or barrier length parameter incorrect or missing.")
 
-    # post-processing
+def postprocess_output(align_result: list[list[str]], hypothesis_temp: list[str], reference_temp: list[str], reference_label: list[str],
+                       strip_punctuation: bool = True) -> dict:
     unique_speaker_label = align4d.get_unique_speaker_label(reference_label)
     if strip_punctuation:
         # for hypothesis
@@ -80,6 +66,179 @@ def align(hypothesis: str | list[str], reference: list[list], partial_bound: int
     return output
 
 
+def get_index_output(align_index: list[bytes], speaker: list) -> dict:
+    # each row is viewed as int32 without creating an object per token
+    output = {"hypothesis": memoryview(align_index[0]).cast('i'), "reference": {}}
+    for i in range(len(speaker)):
+        output["reference"][speaker[i]] = memoryview(align_index[i + 1]).cast('i')
+    return output
+
+
+def get_segment_parameter(hypothesis: str | list[str], segment_length: int = None, barrier_length: int = None) -> tuple:
+    # same segmentation as align(), -1 for automatic segmentation and 0 for no segmentation
+    if (segment_length is None and barrier_length is not None) or (barrier_length is None and segment_length is not None):
+        raise Exception("Segment length or barrier length parameter incorrect or missing.")
+    if segment_length is None and barrier_length is None:
+        return (0, 0) if len(hypothesis) < 100 else (-1, -1)
+    if segment_length <= 0 and barrier_length <= 0:
+        return 0, 0
+    if segment_length <= 0 or barrier_length <= 0:
+        raise Exception("Segment length or barrier length parameter incorrect or missing.")
+    return segment_length, barrier_length
+
+
+def align(hypothesis: str | list[str], reference: list[list], partial_bound: int = 2, segment_length: int = None,
+          barrier_length: int = None, strip_punctuation: bool = True, thread_num: int = 1,
+          band_width: int = 0, engine: str = "dense", store_traceback: bool = False, max_memory_bytes: int = 0,
+          output: str = "token", hypothesis_label: list[str] = None, stats: dict = None) -> dict:
+    # pre-processing
+    hypothesis_temp, reference_temp, reference_label, hypothesis_strip, reference_strip = preprocess_input(hypothesis, reference, strip_punctuation)
+
+    if output == "all":
+        # aligned tokens and all post-processing results from a single native call
+        segment_length, barrier_length = get_segment_parameter(hypothesis, segment_length, barrier_length)
+        return align4d.align_artifact(hypothesis_strip, reference_strip, reference_label, partial_bound, segment_length, barrier_length,
+                                      original_hypothesis=hypothesis_temp, original_reference=reference_temp, hypothesis_label=hypothesis_label,
+                                      thread_num=thread_num, band_width=band_width, engine=engine,
+                                      store_traceback=store_traceback, max_memory_bytes=max_memory_bytes, stats=stats)
+
+    if output == "index":
+        # int32 index of each aligned token in the hypothesis tokens or the (combined) reference tokens, -1 for gaps
+        segment_length, barrier_length = get_segment_parameter(hypothesis, segment_length, barrier_length)
+        result = align4d.align_index(hypothesis_strip, reference_strip, reference_label, partial_bound, segment_length, barrier_length,
+                                     thread_num=thread_num, band_width=band_width, engine=engine,
+                                     store_traceback=store_traceback, max_memory_bytes=max_memory_bytes, stats=stats)
+        return get_index_output(result["align_index"], result["speaker_label"])
+    if output != "token":
+        raise ValueError(f"unknown output: {output}")
+
+    # align
+    if (segment_length is None and barrier_length is not None) or (barrier_length is None and segment_length is not None):
+        raise Exception("Segment length or barrier length parameter incorrect or missing.")
+    if segment_length is None and barrier_length is None:
+        if len(hypothesis) < 100:
+            align_result = align4d.align_without_segment(hypothesis_strip, reference_strip, reference_label, partial_bound, thread_num=thread_num, band_width=band_width, engine=engine, store_traceback=store_traceback, max_memory_bytes=max_memory_bytes, stats=stats)
+        else:
+            align_result = align4d.align_with_auto_segment(hypothesis_strip, reference_strip, reference_label, partial_bound, thread_num=thread_num, band_width=band_width, engine=engine, store_traceback=store_traceback, max_memory_bytes=max_memory_bytes, stats=stats)
+    elif segment_length <= 0 and barrier_length <= 0:
+        align_result = align4d.align_without_segment(hypothesis_strip, reference_strip, reference_label, partial_bound, thread_num=thread_num, band_width=band_width, engine=engine, store_traceback=store_traceback, max_memory_bytes=max_memory_bytes, stats=stats)
+    elif segment_length > 0 and barrier_length > 0:
+        align_result = align4d.align_with_manual_segment(hypothesis_strip, reference_strip, reference_label, segment_length, barrier_length, partial_bound, thread_num=thread_num, band_width=band_width, engine=engine, store_traceback=store_traceback, max_memory_bytes=max_memory_bytes, stats=stats)
+    else:
+        raise Exception("Segment length or barrier length parameter incorrect or missing.")
+
+    # post-processing
+    return postprocess_output(align_result, hypothesis_temp, reference_temp, reference_label, strip_punctuation)
+
+
+def align_batch(job: list[tuple], partial_bound: int = 2, segment_length: int = None, barrier_length: int = None,
+                strip_punctuation: bool = True, thread_num: int = 0, band_width: int = 0, engine: str = "dense",
+                store_traceback: bool = False, max_memory_bytes: int = 0, stats: dict = None) -> list[dict]:
+    # pre-processing, each job is a tuple of (hypothesis, reference) in the same format as align()
+    native_job = []
+    job_input = []
+    for hypothesis, reference in job:
+        hypothesis_temp, reference_temp, reference_label, hypothesis_strip, reference_strip = preprocess_input(hypothesis, reference, strip_punctuation)
+        job_segment_length, job_barrier_length = get_segment_parameter(hypothesis, segment_length, barrier_length)
+        native_job.append((hypothesis_strip, reference_strip, reference_label, job_segment_length, job_barrier_length))
+        job_input.append((hypothesis_temp, reference_temp, reference_label))
+
+    # align all jobs in parallel
+    align_result_list = align4d.align_batch(native_job, partial_bound, thread_num=thread_num, band_width=band_width, engine=engine,
+                                            store_traceback=store_traceback, max_memory_bytes=max_memory_bytes, stats=stats)
+
+    # post-processing
+    return [postprocess_output(align_result, hypothesis_temp, reference_temp, reference_label, strip_punctuation)
+            for align_result, (hypothesis_temp, reference_temp, reference_label) in zip(align_result_list, job_input)]
+
+
+def align_token_id(hypothesis, reference, reference_label, partial_match=None, segment_length: int = None, barrier_length: int = None,
+                   thread_num: int = 1, band_width: int = 0, engine: str = "dense", store_traceback: bool = False,
+                   max_memory_bytes: int = 0, output: str = "token", stats: dict = None) -> dict:
+    # hypothesis, reference and reference_label are int32 arrays (such as NumPy arrays) of non-negative ids read without copying
+    segment_length, barrier_length = get_segment_parameter(hypothesis, segment_length, barrier_length)
+    result = align4d.align_token_id(hypothesis, reference, reference_label, partial_match, segment_length, barrier_length,
+                                    thread_num=thread_num, band_width=band_width, engine=engine,
+                                    store_traceback=store_traceback, max_memory_bytes=max_memory_bytes, output=output, stats=stats)
+    if output == "index":
+        return get_index_output(result["align_index"], result["speaker_id"])
+    align_result = result["align_result"]
+    output = {"hypothesis": align_result[0], "reference": {}}
+    for i in range(len(result["speaker_id"])):
+        output["reference"][result["speaker_id"][i]] = align_result[i + 1]
+    return output
+
+
+def estimate_cost(hypothesis: str | list[str], reference: list[list], segment_length: int = None, barrier_length: int = None,
+                  strip_punctuation: bool = True, thread_num: int = 1, band_width: int = 0, engine: str = "dense",
+                  store_traceback: bool = False, max_memory_bytes: int = 0) -> list[dict]:
+    hypothesis_temp, reference_temp, reference_label, hypothesis_strip, reference_strip = preprocess_input(hypothesis, reference, strip_punctuation)
+
+    segment_length, barrier_length = get_segment_parameter(hypothesis, segment_length, barrier_length)
+    return align4d.estimate_alignment_cost(hypothesis_strip, reference_strip, reference_label, segment_length, barrier_length,
+                                           thread_num=thread_num, band_width=band_width, engine=engine,
+                                           store_traceback=store_traceback, max_memory_bytes=max_memory_bytes)
+
+
+class StreamAligner:
+    def __init__(self, partial_bound: int = 2, segment_length: int = 30, barrier_length: int = 6, strip_punctuation: bool = True,
+                 thread_num: int = 1, band_width: int = 0, engine: str = "dense", store_traceback: bool = False,
+                 max_memory_bytes: int = 0):
+        self.aligner = align4d.StreamAligner(segment_length=segment_length, barrier_length=barrier_length, partial_bound=partial_bound,
+                                             thread_num=thread_num, band_width=band_width, engine=engine,
+                                             store_traceback=store_traceback, max_memory_bytes=max_memory_bytes)
+        self.strip_punctuation = strip_punctuation
+        # original tokens that are not emitted yet
+        self.hypothesis_pending = []
+        self.reference_pending = []
+        self.reference_label_pending = []
+
+    def append(self, hypothesis: str | list[str] = None, reference: list[list] = None):
+        hypothesis_temp, reference_temp, reference_label, hypothesis_strip, reference_strip = preprocess_input(
+            hypothesis if hypothesis is not None else [], reference if reference is not None else [], self.strip_punctuation)
+        self.aligner.append(hypothesis_strip, reference_strip, reference_label)
+        self.hypothesis_pending.extend(hypothesis_temp)
+        self.reference_pending.extend(reference_temp)
+        self.reference_label_pending.extend(reference_label)
+
+    def emit(self) -> dict:
+        return self._get_output(self.aligner.emit())
+
+    def flush(self) -> dict:
+        return self._get_output(self.aligner.flush())
+
+    def _get_output(self, result: dict) -> dict:
+        align_result = result["align_result"]
+        unique_speaker_label = result["speaker_label"]
+        output = {"hypothesis": [], "reference": {}, "hypothesis_start": result["hypothesis_start"], "reference_start": result["reference_start"]}
+        if not align_result:
+            return output
+        hypothesis_num = sum(1 for token in align_result[0] if token != '-')
+        reference_num = sum(1 for row in align_result[1:] for token in row if token != '-')
+        # put the original tokens (with punctuation) back
+        hypo_index = 0
+        for i in range(len(align_result[0])):
+            if align_result[0][i] != '-':
+                align_result[0][i] = self.hypothesis_pending[hypo_index]
+                hypo_index += 1
+        output_index = [0 for _ in range(len(align_result))]
+        for i in range(reference_num):
+            speaker_index = unique_speaker_label.index(self.reference_label_pending[i]) + 1
+            while output_index[speaker_index] < len(align_result[0]) and align_result[speaker_index][output_index[speaker_index]] == '-':
+                output_index[speaker_index] += 1
+            align_result[speaker_index][output_index[speaker_index]] = self.reference_pending[i]
+            output_index[speaker_index] += 1
+        del self.hypothesis_pending[:hypothesis_num]
+        del self.reference_pending[:reference_num]
+        del self.reference_label_pending[:reference_num]
+
+        align_result = [[s if s != '-' else '' for s in seq] for seq in align_result]
+        output["hypothesis"] = align_result[0]
+        for i in range(len(unique_speaker_label)):
+            output["reference"][f"{unique_speaker_label[i]}"] = align_result[i + 1]
+        return output
+
+
 def token_match(output: dict, partial_bound: int = 2, strip_punctuation: bool = True) -> list[str]:
     align_result = [output["hypothesis"]]
     for value in output["reference"].values():
@@ -1,18 +1,67 @@
 def align_without_segment(hypothesis: list[str], reference: list[str], reference_label: list[str],
-                          partial_bound: int = 2) -> list[list[str]]:
+                          partial_bound: int = 2, thread_num: int = 1, band_width: int = 0, engine: str = "dense",
+                          store_traceback: bool = False, max_memory_bytes: int = 0, stats: dict = None) -> list[list[str]]:
     pass
 
 
 def align_with_auto_segment(hypothesis: list[str], reference: list[str], reference_label: list[str],
-                            partial_bound: int = 2) -> list[list[str]]:
+                            partial_bound: int = 2, thread_num: int = 1, band_width: int = 0, engine: str = "dense",
+                          store_traceback: bool = False, max_memory_bytes: int = 0, stats: dict = None) -> list[list[str]]:
     pass
 
 
 def align_with_manual_segment(hypothesis: list[str], reference: list[str], reference_label: list[str],
-                              segment_length: int, barrier_length: int, partial_bound: int = 2) -> list[list[str]]:
+                              segment_length: int, barrier_length: int, partial_bound: int = 2,
+                              thread_num: int = 1, band_width: int = 0, engine: str = "dense",
+                              store_traceback: bool = False, max_memory_bytes: int = 0, stats: dict = None) -> list[list[str]]:
     pass
 
 
+def align_batch(job: list[tuple], partial_bound: int = 2, thread_num: int = 0, band_width: int = 0, engine: str = "dense",
+                store_traceback: bool = False, max_memory_bytes: int = 0, stats: dict = None) -> list[list[list[str]]]:
+    pass
+
+
+def align_token_id(hypothesis, reference, reference_label, partial_match=None, segment_length: int = 0, barrier_length: int = 0,
+                   thread_num: int = 1, band_width: int = 0, engine: str = "dense", store_traceback: bool = False,
+                   max_memory_bytes: int = 0, output: str = "token", stats: dict = None) -> dict:
+    pass
+
+
+def align_artifact(hypothesis: list[str], reference: list[str], reference_label: list[str], partial_bound: int = 2,
+                   segment_length: int = 0, barrier_length: int = 0, original_hypothesis: list[str] = None,
+                   original_reference: list[str] = None, hypothesis_label: list[str] = None, thread_num: int = 1,
+                   band_width: int = 0, engine: str = "dense", store_traceback: bool = False, max_memory_bytes: int = 0, stats: dict = None) -> dict:
+    pass
+
+
+def align_index(hypothesis: list[str], reference: list[str], reference_label: list[str], partial_bound: int = 2,
+                segment_length: int = 0, barrier_length: int = 0, thread_num: int = 1, band_width: int = 0,
+                engine: str = "dense", store_traceback: bool = False, max_memory_bytes: int = 0, stats: dict = None) -> dict:
+    pass
+
+
+def estimate_alignment_cost(hypothesis: list[str], reference: list[str], reference_label: list[str],
+                            segment_length: int = 0, barrier_length: int = 0, thread_num: int = 1, band_width: int = 0,
+                            engine: str = "dense", store_traceback: bool = False, max_memory_bytes: int = 0) -> list[dict]:
+    pass
+
+
+class StreamAligner:
+    def __init__(self, segment_length: int = 30, barrier_length: int = 6, partial_bound: int = 2, thread_num: int = 1,
+                 band_width: int = 0, engine: str = "dense", store_traceback: bool = False, max_memory_bytes: int = 0):
+        pass
+
+    def append(self, hypothesis: list[str], reference: list[str] = None, reference_label: list[str] = None) -> None:
+        pass
+
+    def emit(self) -> dict:
+        pass
+
+    def flush(self) -> dict:
+        pass
+
+
 def get_token_match_result(align_result: list[list[str]], partial_bound: int = 2) -> list[str]:
     pass
 
@@ -1,119 +1,496 @@
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <numeric>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "align.h"
 #include "msa.h"
 #include "preprocess.h"
 #include "postprocess.h"
+#include "thread_pool.h"
 
-std::vector<std::vector<std::string>> align_without_segment(const std::vector<std::string>& hypothesis, const std::vector<std::string>& reference, const std::vector<std::string>& reference_label, int partial_bound) {
-    // get unique speaker labels
-    std::vector<std::string> unique_speaker_label = get_unique_speaker_label(reference_label);
-    // separate reference to multiple sequences by speaker label
-    std::vector<std::vector<std::string>> separated_ref = get_separate_sequence(reference, reference_label);
-    // align
-    auto start = std::chrono::high_resolution_clock::now();
-    auto align_result = multi_sequence_alignment(hypothesis, separated_ref, partial_bound);
-    auto end = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::seconds>(end - start);
-    std::cout << "\ntime: " << duration.count() << std::endl;
-    return align_result;
+msa_config get_segment_config(const msa_config& config, size_t segment_num) {
+    /*
+     * Get the options of the alignment engine for each segment, segments aligned in parallel use a single thread each
+     */
+    msa_config segment_config = config;
+    if (get_thread_num(config.thread_num) > 1 && segment_num > 1) {
+        segment_config.thread_num = 1;
+    }
+    return segment_config;
+}
+
+interned_input intern_input(const std::vector<std::string>& hypothesis, const std::vector<std::string>& reference, const std::vector<std::string>& reference_label) {
+    /*
+     * Intern the tokens once for the whole input and map the speaker labels to dense ids in sorted order,
+     * the scores of the interned tokens are the same as the interning of each segment
+     *
+     * @return: vocabulary, token ids of hypothesis and reference, unique speaker labels and the id of each reference label
+     */
+    if (reference.size() != reference_label.size()) {
+        throw std::invalid_argument("reference and reference_label must have the same length");
+    }
+    interned_input input;
+    input.label_index = get_speaker_label_index(reference_label);
+    token_interner interner(input.vocabulary);
+    input.hypothesis_id = interner.intern(hypothesis);
+    input.reference_id = interner.intern(reference);
+    return input;
 }
 
-std::vector<std::vector<std::string>> align_with_auto_segment(const std::vector<std::string>& hypothesis, const std::vector<std::string>& reference, const std::vector<std::string>& reference_label, int partial_bound) {
-    // get unique speaker labels
-    std::vector<std::string> unique_speaker_label = get_unique_speaker_label(reference_label);
-
-    // segment dialogue
-    auto [optimal_segment_length, optimal_barrier_length] = get_optimal_segment_parameter(hypothesis, reference);
-    std::vector<std::vector<int>> segment_index = get_segment_index(hypothesis, reference, optimal_segment_length, optimal_barrier_length);
-    std::vector<std::vector<std::string>> segmented_hypothesis_list = get_segment_sequence(hypothesis, segment_index[0]);
-    std::vector<std::vector<std::string>> segmented_reference_list = get_segment_sequence(reference, segment_index[1]);
-    std::vector<std::vector<std::string>> segmented_reference_label_list = get_segment_sequence(reference_label, segment_index[1]);
-
-    // align each segment separately, record time, and put all back together
-    std::vector<std::vector<std::string>> align_result(unique_speaker_label.size() + 1);
-    long long total_time{0};
-    for (int i = 0; i < segmented_hypothesis_list.size(); ++i) {
-        std::cout << " segment from: " << segment_index[0][i] << " to: " << segment_index[0][i + 1];
-        auto segment_hypothesis = segmented_hypothesis_list[i];
-        auto separated_reference_with_label = get_separate_sequence_with_label(segmented_reference_list[i], segmented_reference_label_list[i]);
-        std::vector<std::vector<std::string>> separated_reference(separated_reference_with_label.begin(), separated_reference_with_label.end() - 1);
-        std::vector<std::string> segment_reference_speaker_label = separated_reference_with_label.back();
-
-        auto start = std::chrono::high_resolution_clock::now();
-        auto result = multi_sequence_alignment(segment_hypothesis, separated_reference, partial_bound);
-        auto end = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::seconds>(end - start);
-        std::cout << " segment time: " << duration.count() << std::endl;
-        total_time += duration.count();
-
-        align_result[0].insert(align_result[0].end(), result[0].begin(), result[0].end());
-        for (int j = 0; j < separated_reference.size(); ++j) {
-            int final_result_index = std::ranges::find(unique_speaker_label, segment_reference_speaker_label[j]) - unique_speaker_label.begin() + 1;
-            align_result[final_result_index].insert(align_result[final_result_index].end(), result[j + 1].begin(), result[j + 1].end());
-        }
-        for (int j = 1; j < align_result.size(); ++j) {
-            while (align_result[j].size() < align_result[0].size()) {
-                align_result[j].emplace_back(GAP);
+score_table_function get_interned_score_table(const interned_input& input, int partial_bound) {
+    /*
+     * Score table of the interned tokens of a segment, tokens are partially matched by edit distance
+     */
+    return [&input, partial_bound](const std::vector<std::vector<uint32_t>>& token_id_sequence) {
+        return get_score_table(token_id_sequence, input.vocabulary, partial_bound);
+    };
+}
+
+std::vector<std::vector<int>> get_token_id_segment_index(std::span<const uint32_t> hypothesis, std::span<const uint32_t> reference, int segment_length, int barrier_length, const msa_config& config) {
+    /*
+     * Segment token ids with the segmentation selected by segment length and barrier length,
+     * the segmentation is the same as the segmentation of the tokens of the ids.
+     *
+     * @param segment_length: SEGMENT_AUTO (with barrier_length SEGMENT_AUTO) for automatic segmentation,
+     * positive (with positive barrier_length) for manual segmentation, otherwise no segmentation
+     * @param barrier_length: SEGMENT_AUTO or the barrier length of manual segmentation
+     * @return: index of segmentation of hypothesis and reference, see get_segment_index
+     */
+    if (segment_length == SEGMENT_AUTO && barrier_length == SEGMENT_AUTO) {
+        stage_timer table_timer(config.stats, &alignment_stats::segmentation_nanosecond);
+        barrier_table table = get_barrier_table(hypothesis, reference, AUTO_SEGMENT_BARRIER_LENGTH);
+        table_timer.stop();
+        stage_timer parameter_search_timer(config.stats, &alignment_stats::parameter_search_nanosecond);
+        auto [optimal_segment_length, optimal_barrier_length] = get_optimal_segment_parameter(table, AUTO_SEGMENT_MIN_LENGTH, AUTO_SEGMENT_MAX_LENGTH,
+                                                                                              get_thread_num(config.thread_num));
+        parameter_search_timer.stop();
+        stage_timer segmentation_timer(config.stats, &alignment_stats::segmentation_nanosecond);
+        return get_segment_index(table, optimal_segment_length);
+    }
+    if (segment_length > 0 && barrier_length > 0) {
+        stage_timer segmentation_timer(config.stats, &alignment_stats::segmentation_nanosecond);
+        return get_segment_index(get_barrier_table(hypothesis, reference, barrier_length), segment_length);
+    }
+    return {{0, (int)hypothesis.size()}, {0, (int)reference.size()}};
+}
+
+token_id_alignment align_token_id_segment(std::span<const uint32_t> hypothesis, std::span<const uint32_t> reference, std::span<const uint32_t> label_id, size_t speaker_num,
+                                          const std::vector<std::vector<int>>& segment_index, const score_table_function& get_table, const msa_config& config) {
+    /*
+     * Align each segment of token ids separately and put all segments back together in order.
+     *
+     * With more than 1 thread, the segments are aligned in parallel by a work-stealing thread pool starting from the largest one,
+     * each segment uses a single thread for its own alignment, and the total number of scoring matrix cells
+     * of the segments aligned at the same time is limited by max_parallel_cell of the config.
+     * With max_memory_bytes, every segment is planned within the budget before any alignment starts
+     * (memory_budget_error is thrown if one does not fit), and the total memory of the segments aligned at the same time
+     * is also limited by the budget.
+     * With stats in the config, each segment fills its own stats, which are added to the stats of the config in order.
+     *
+     * @param label_id: dense speaker id (less than speaker_num) of each reference token
+     * @param speaker_num: number of speakers, one reference row for each
+     * @param segment_index: index of segmentation of hypothesis and reference from get_segment_index
+     * @param get_table: score table of the token ids of the hypothesis and separated references of a segment
+     * @return: aligned index of the hypothesis and the reference of each speaker (by dense speaker id) and match type of each column,
+     * speaker_id is left empty for the caller
+     */
+    if (reference.size() != label_id.size()) {
+        throw std::invalid_argument("reference and reference_label must have the same length");
+    }
+    // separate each segment by speaker and plan it within the memory budget before any alignment starts
+    stage_timer stitch_timer(config.stats, &alignment_stats::stitch_nanosecond);
+    size_t segment_num = segment_index[0].size() - 1;
+    int thread_num = get_thread_num(config.thread_num);
+    msa_config segment_config = get_segment_config(config, segment_num);
+    std::vector<std::vector<std::vector<uint32_t>>> token_id_sequence_list(segment_num);
+    std::vector<std::vector<uint32_t>> segment_speaker_list(segment_num);                // dense id of each separated reference
+    std::vector<std::vector<std::vector<int>>> reference_position_list(segment_num);     // original reference index of each separated token
+    std::vector<msa_config> segment_config_list(segment_num);
+    std::vector<size_t> segment_cell(segment_num);
+    std::vector<size_t> segment_byte(segment_num);
+    std::vector<int> speaker_row(speaker_num, -1);
+    for (int i = 0; i < segment_num; ++i) {
+        std::vector<std::vector<uint32_t>>& token_id_sequence = token_id_sequence_list[i];
+        token_id_sequence.emplace_back(hypothesis.begin() + segment_index[0][i], hypothesis.begin() + segment_index[0][i + 1]);
+        // the speakers in the segment are in ascending order of dense id
+        std::span<const uint32_t> segment_label_id = label_id.subspan(segment_index[1][i], segment_index[1][i + 1] - segment_index[1][i]);
+        segment_speaker_list[i] = get_segment_speaker(segment_label_id, speaker_row);
+        token_id_sequence.resize(segment_speaker_list[i].size() + 1);
+        reference_position_list[i].resize(segment_speaker_list[i].size());
+        for (int j = 0; j < segment_label_id.size(); ++j) {
+            int row = speaker_row[segment_label_id[j]];
+            token_id_sequence[row + 1].emplace_back(reference[segment_index[1][i] + j]);
+            reference_position_list[i][row].emplace_back(segment_index[1][i] + j);
+        }
+        for (uint32_t speaker: segment_speaker_list[i]) {
+            speaker_row[speaker] = -1;
+        }
+        std::vector<size_t> sequence_length = get_sequence_length(token_id_sequence);
+        segment_cell[i] = 1;
+        for (size_t length: sequence_length) {
+            segment_cell[i] *= length + 1;
+        }
+        segment_config_list[i] = plan_alignment(sequence_length, segment_config);
+        segment_byte[i] = get_alignment_cost(sequence_length, segment_config_list[i]).byte;
+    }
+    stitch_timer.stop();
+
+    // align each segment separately and record time
+    std::vector<std::vector<std::vector<int>>> segment_result(segment_num);
+    std::vector<std::vector<token_match_type>> segment_match(segment_num);
+    std::vector<alignment_stats> segment_stats(config.stats ? segment_num : 0);
+    auto align_single_segment = [&](int i) {
+        auto start = std::chrono::steady_clock::now();
+        alignment_stats *stats = config.stats ? &segment_stats[i] : nullptr;
+        segment_config_list[i].stats = stats;
+        stage_timer score_table_timer(stats, &alignment_stats::score_table_nanosecond);
+        score_table table = get_table(token_id_sequence_list[i]);
+        add_score_table_stats(stats, table);
+        score_table_timer.stop();
+        segment_result[i] = multi_sequence_alignment_index(token_id_sequence_list[i], table, segment_config_list[i]);
+        segment_match[i] = get_column_match(segment_result[i], table);
+        if (stats) {
+            stats->segment_nanosecond.emplace_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        }
+    };
+    if (thread_num <= 1 || segment_num <= 1) {
+        for (int i = 0; i < segment_num; ++i) {
+            align_single_segment(i);
+        }
+    } else {
+        std::vector<int> order(segment_num);
+        std::iota(order.begin(), order.end(), 0);
+        std::ranges::stable_sort(order, [&](int a, int b) { return segment_cell[a] > segment_cell[b]; });
+        cell_limiter limiter(config.max_parallel_cell);
+        cell_limiter memory_limiter(config.max_memory_bytes != 0 ? config.max_memory_bytes : SIZE_MAX);
+        thread_pool pool(std::min<int>(thread_num, (int)segment_num));
+        for (int i: order) {
+            pool.submit([&, i]() {
+                limiter.acquire(segment_cell[i]);
+                memory_limiter.acquire(segment_byte[i]);
+                try {
+                    align_single_segment(i);
+                } catch (...) {
+                    memory_limiter.release(segment_byte[i]);
+                    limiter.release(segment_cell[i]);
+                    throw;
+                }
+                memory_limiter.release(segment_byte[i]);
+                limiter.release(segment_cell[i]);
+            });
+        }
+        pool.wait();
+    }
+
+    // put all back together with the index in the original sequences, a speaker missing in a segment is filled with -1
+    // when it appears again or at the end
+    stage_timer put_back_timer(config.stats, &alignment_stats::stitch_nanosecond);
+    token_id_alignment result;
+    result.align_index.resize(speaker_num + 1);
+    for (int i = 0; i < segment_num; ++i) {
+        const std::vector<std::vector<int>>& index = segment_result[i];
+        size_t column_start = result.align_index[0].size();
+        result.column_match.insert(result.column_match.end(), segment_match[i].begin(), segment_match[i].end());
+        for (int position: index[0]) {
+            result.align_index[0].emplace_back(position != -1 ? position + segment_index[0][i] : -1);
+        }
+        for (int j = 0; j < segment_speaker_list[i].size(); ++j) {
+            std::vector<int>& row = result.align_index[segment_speaker_list[i][j] + 1];
+            row.resize(column_start, -1);
+            for (int position: index[j + 1]) {
+                row.emplace_back(position != -1 ? reference_position_list[i][j][position] : -1);
             }
         }
     }
-    std::cout << "total time: " << total_time << std::endl;
+    for (int j = 1; j < result.align_index.size(); ++j) {
+        result.align_index[j].resize(result.align_index[0].size(), -1);
+    }
+    put_back_timer.stop();
+    if (config.stats) {
+        config.stats->segment_num += segment_num;
+        for (const alignment_stats& stats: segment_stats) {
+            add_alignment_stats(*config.stats, stats);
+        }
+    }
+    return result;
+}
+
+std::vector<std::vector<std::string>> get_align_token(const token_id_alignment& result, const std::vector<std::string>& hypothesis, const std::vector<std::string>& reference) {
+    /*
+     * Convert the aligned index of the hypothesis and the references back to tokens, -1 is converted to GAP
+     */
+    std::vector<std::vector<std::string>> align_result(result.align_index.size());
+    for (int i = 0; i < result.align_index.size(); ++i) {
+        const std::vector<std::string>& sequence = i == 0 ? hypothesis : reference;
+        align_result[i].reserve(result.align_index[i].size());
+        for (int position: result.align_index[i]) {
+            align_result[i].emplace_back(position != -1 ? sequence[position] : GAP);
+        }
+    }
     return align_result;
 }
 
-std::vector<std::vector<std::string>> align_with_manual_segment(const std::vector<std::string>& hypothesis, const std::vector<std::string>& reference, const std::vector<std::string>& reference_label, int segment_length, int barrier_length, int partial_bound) {
-    // get unique speaker labels
-    std::vector<std::string> unique_speaker_label = get_unique_speaker_label(reference_label);
-
-    // segment dialogue
-    std::vector<std::vector<int>> segment_index = get_segment_index(hypothesis, reference, segment_length, barrier_length);
-    std::vector<std::vector<std::string>> segmented_hypothesis_list = get_segment_sequence(hypothesis, segment_index[0]);
-    std::vector<std::vector<std::string>> segmented_reference_list = get_segment_sequence(reference, segment_index[1]);
-    std::vector<std::vector<std::string>> segmented_reference_label_list = get_segment_sequence(reference_label, segment_index[1]);
-
-    // align each segment separately, record time, and put all back together
-    std::vector<std::vector<std::string>> align_result(unique_speaker_label.size() + 1);
-    long long total_time{0};
-    for (int i = 0; i < segmented_hypothesis_list.size(); ++i) {
-        std::cout << " segment from: " << segment_index[0][i] << " to: " << segment_index[0][i + 1];
-        auto segment_hypothesis = segmented_hypothesis_list[i];
-        auto separated_reference_with_label = get_separate_sequence_with_label(segmented_reference_list[i], segmented_reference_label_list[i]);
-        std::vector<std::vector<std::string>> separated_reference(separated_reference_with_label.begin(), separated_reference_with_label.end() - 1);
-        std::vector<std::string> segment_reference_speaker_label = separated_reference_with_label.back();
-
-        auto start = std::chrono::high_resolution_clock::now();
-        auto result = multi_sequence_alignment(segment_hypothesis, separated_reference, partial_bound);
-        auto end = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::seconds>(end - start);
-        std::cout << " segment time: " << duration.count() << std::endl;
-        total_time += duration.count();
-
-        align_result[0].insert(align_result[0].end(), result[0].begin(), result[0].end());
-        for (int j = 0; j < separated_reference.size(); ++j) {
-            int final_result_index = std::ranges::find(unique_speaker_label, segment_reference_speaker_label[j]) - unique_speaker_label.begin() + 1;
-            align_result[final_result_index].insert(align_result[final_result_index].end(), result[j + 1].begin(), result[j + 1].end());
-        }
-        for (int j = 1; j < align_result.size(); ++j) {
-            while (align_result[j].size() < align_result[0].size()) {
-                align_result[j].emplace_back(GAP);
+std::vector<std::vector<std::string>> align_segment(const std::vector<std::string>& hypothesis, const std::vector<std::string>& reference, const std::vector<std::string>& reference_label, const std::vector<std::vector<int>>& segment_index, int partial_bound, const msa_config& config) {
+    /*
+     * Align each segment separately and put all segments back together in order, the tokens are interned once
+     * and the segments are aligned by align_token_id_segment.
+     *
+     * @param segment_index: index of segmentation of hypothesis and reference from get_segment_index
+     * @return: aligned hypothesis and references of all speakers (sorted by speaker label) as 2d vector of strings
+     */
+    stage_timer intern_timer(config.stats, &alignment_stats::stitch_nanosecond);
+    interned_input input = intern_input(hypothesis, reference, reference_label);
+    intern_timer.stop();
+    token_id_alignment result = align_token_id_segment(input.hypothesis_id, input.reference_id, input.label_index.label_id, input.label_index.unique_speaker_label.size(),
+                                                       segment_index, get_interned_score_table(input, partial_bound), config);
+    stage_timer put_back_timer(config.stats, &alignment_stats::stitch_nanosecond);
+    return get_align_token(result, hypothesis, reference);
+}
+
+std::vector<std::vector<std::string>> align_with_segment(const std::vector<std::string>& hypothesis, const std::vector<std::string>& reference, const std::vector<std::string>& reference_label,
+                                                         int segment_length, int barrier_length, int partial_bound, const msa_config& config) {
+    /*
+     * Align tokens with the segmentation selected by segment length and barrier length, the tokens are interned once
+     * for both the segmentation and the alignment.
+     *
+     * @param segment_length: SEGMENT_AUTO (with barrier_length SEGMENT_AUTO) for automatic segmentation,
+     * positive (with positive barrier_length) for manual segmentation, otherwise no segmentation
+     * @param barrier_length: SEGMENT_AUTO or the barrier length of manual segmentation
+     * @return: aligned hypothesis and references of all speakers (sorted by speaker label) as 2d vector of strings
+     */
+    stage_timer total_timer(config.stats, &alignment_stats::total_nanosecond);
+    stage_timer intern_timer(config.stats, &alignment_stats::stitch_nanosecond);
+    interned_input input = intern_input(hypothesis, reference, reference_label);
+    intern_timer.stop();
+    std::vector<std::vector<int>> segment_index = get_token_id_segment_index(input.hypothesis_id, input.reference_id, segment_length, barrier_length, config);
+    token_id_alignment result = align_token_id_segment(input.hypothesis_id, input.reference_id, input.label_index.label_id, input.label_index.unique_speaker_label.size(),
+                                                       segment_index, get_interned_score_table(input, partial_bound), config);
+    stage_timer put_back_timer(config.stats, &alignment_stats::stitch_nanosecond);
+    return get_align_token(result, hypothesis, reference);
+}
+
+std::vector<std::vector<std::string>> align_without_segment(const std::vector<std::string>& hypothesis, const std::vector<std::string>& reference, const std::vector<std::string>& reference_label, int partial_bound, const msa_config& config) {
+    return align_with_segment(hypothesis, reference, reference_label, 0, 0, partial_bound, config);
+}
+
+std::vector<std::vector<std::string>> align_with_auto_segment(const std::vector<std::string>& hypothesis, const std::vector<std::string>& reference, const std::vector<std::string>& reference_label, int partial_bound, const msa_config& config) {
+    return align_with_segment(hypothesis, reference, reference_label, SEGMENT_AUTO, SEGMENT_AUTO, partial_bound, config);
+}
+
+std::vector<std::vector<std::string>> align_with_manual_segment(const std::vector<std::string>& hypothesis, const std::vector<std::string>& reference, const std::vector<std::string>& reference_label, int segment_length, int barrier_length, int partial_bound, const msa_config& config) {
+    return align_with_segment(hypothesis, reference, reference_label, segment_length, barrier_length, partial_bound, config);
+}
+
+std::vector<segment_cost> estimate_alignment_cost(const std::vector<std::string>& hypothesis, const std::vector<std::string>& reference, const std::vector<std::string>& reference_label, int segment_length, int barrier_length, const msa_config& config) {
+    /*
+     * Predict the cost of each segment of an alignment without doing the alignment or allocating the scoring matrix,
+     * the segments and engines are the same as the align functions with the same parameters would use.
+     *
+     * @param segment_length: SEGMENT_AUTO (with barrier_length SEGMENT_AUTO) for automatic segmentation,
+     * positive (with positive barrier_length) for manual segmentation, otherwise no segmentation
+     * @param barrier_length: SEGMENT_AUTO or the barrier length of manual segmentation
+     * @param config: options of the alignment engine
+     * @return: hypothesis and reference range and predicted cost of each segment,
+     * a segment that does not fit in max_memory_bytes of the config has the cost of the linear memory engine
+     */
+    interned_input input = intern_input(hypothesis, reference, reference_label);
+    msa_config segmentation_config = config;
+    segmentation_config.stats = nullptr;
+    std::vector<std::vector<int>> segment_index = get_token_id_segment_index(input.hypothesis_id, input.reference_id, segment_length, barrier_length, segmentation_config);
+
+    size_t segment_num = segment_index[0].size() - 1;
+    msa_config segment_config = get_segment_config(config, segment_num);
+    const speaker_label_index& label_index = input.label_index;
+    std::vector<int> speaker_row(label_index.unique_speaker_label.size(), -1);
+    std::vector<segment_cost> cost_list;
+    for (int i = 0; i < segment_num; ++i) {
+        segment_cost cost{segment_index[0][i], segment_index[0][i + 1], segment_index[1][i], segment_index[1][i + 1], {}};
+        std::span<const uint32_t> segment_label_id(label_index.label_id.begin() + cost.reference_start, label_index.label_id.begin() + cost.reference_end);
+        std::vector<size_t> sequence_length{(size_t)(cost.hypothesis_end - cost.hypothesis_start)};
+        std::vector<uint32_t> segment_speaker = get_segment_speaker(segment_label_id, speaker_row);
+        sequence_length.resize(segment_speaker.size() + 1, 0);
+        for (uint32_t id: segment_label_id) {
+            ++sequence_length[speaker_row[id] + 1];
+        }
+        for (uint32_t speaker: segment_speaker) {
+            speaker_row[speaker] = -1;
+        }
+        try {
+            cost.cost = get_alignment_cost(sequence_length, plan_alignment(sequence_length, segment_config));
+        } catch (const memory_budget_error&) {
+            // the dense engine falls back to the linear memory engine, the other engines have no fallback
+            msa_config fallback_config = segment_config;
+            if (fallback_config.engine == msa_engine::dense) {
+                fallback_config.engine = msa_engine::linear_memory;
             }
+            cost.cost = get_alignment_cost(sequence_length, fallback_config);
+            cost.within_budget = false;
         }
+        cost_list.emplace_back(cost);
     }
-    std::cout << "total time: " << total_time << std::endl;
-    return align_result;
+    return cost_list;
+}
+
+std::vector<std::vector<std::string>> align_job(const alignment_job& job, int partial_bound, const msa_config& config) {
+    /*
+     * Align a single job with the segmentation selected by its segment length and barrier length
+     */
+    return align_with_segment(job.hypothesis, job.reference, job.reference_label, job.segment_length, job.barrier_length, partial_bound, config);
+}
+
+std::vector<std::vector<std::vector<std::string>>> align_batch(const std::vector<alignment_job>& job_list, int partial_bound, const msa_config& config) {
+    /*
+     * Align many independent jobs (such as conversations) in parallel by a work-stealing thread pool starting from the largest one,
+     * each job uses a single thread for its own alignment.
+     * With max_memory_bytes, the total memory of the jobs aligned at the same time is limited by the budget,
+     * and every job is checked against the budget before any alignment starts.
+     * With stats in the config, each job fills its own stats, which are added to the stats of the config in the order of job_list.
+     *
+     * @param job_list: hypothesis, reference, reference label and segmentation of each job
+     * @param partial_bound: upper bound (exclusive) of edit distance for two tokens to be partially matched
+     * @param config: options of the alignment engine, thread_num is the number of jobs aligned at the same time
+     * @return: aligned hypothesis and references of all speakers (sorted by speaker label) of each job in the same order as job_list
+     */
+    msa_config job_config = config;
+    job_config.thread_num = 1;
+    job_config.stats = nullptr;
+    size_t job_num = job_list.size();
+    std::vector<size_t> job_cell(job_num), job_byte(job_num, 0);
+    for (int i = 0; i < job_num; ++i) {
+        const alignment_job& job = job_list[i];
+        if (job.reference.size() != job.reference_label.size()) {
+            throw std::invalid_argument("job " + std::to_string(i) + ": reference and reference_label must have the same length");
+        }
+        job_cell[i] = (job.hypothesis.size() + 1) * (job.reference.size() + 1);
+        if (config.max_memory_bytes != 0) {
+            for (const segment_cost& cost: estimate_alignment_cost(job.hypothesis, job.reference, job.reference_label, job.segment_length, job.barrier_length, job_config)) {
+                if (!cost.within_budget) {
+                    throw memory_budget_error("job " + std::to_string(i) + " needs " + std::to_string(cost.cost.byte) + " bytes of memory, exceeding the budget of "
+                                              + std::to_string(config.max_memory_bytes) + " bytes");
+                }
+                job_byte[i] = std::max(job_byte[i], cost.cost.byte);
+            }
+        }
+    }
+
+    std::vector<std::vector<std::vector<std::string>>> result(job_num);
+    std::vector<alignment_stats> job_stats(config.stats ? job_num : 0);
+    std::vector<int> order(job_num);
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::stable_sort(order, [&](int a, int b) { return job_cell[a] > job_cell[b]; });
+    cell_limiter memory_limiter(config.max_memory_bytes != 0 ? config.max_memory_bytes : SIZE_MAX);
+    thread_pool pool(std::min<int>(get_thread_num(config.thread_num), std::max<int>((int)job_num, 1)));
+    for (int i: order) {
+        pool.submit([&, i]() {
+            memory_limiter.acquire(job_byte[i]);
+            try {
+                msa_config stats_config = job_config;
+                stats_config.stats = config.stats ? &job_stats[i] : nullptr;
+                result[i] = align_job(job_list[i], partial_bound, stats_config);
+            } catch (...) {
+                memory_limiter.release(job_byte[i]);
+                throw;
+            }
+            memory_limiter.release(job_byte[i]);
+        });
+    }
+    pool.wait();
+    for (const alignment_stats& stats: job_stats) {
+        add_alignment_stats(*config.stats, stats);
+    }
+    return result;
+}
+
+token_id_alignment align_token_id(std::span<const uint32_t> hypothesis, std::span<const uint32_t> reference, std::span<const uint32_t> reference_label,
+                                  const partial_match_function& is_partial_match, int segment_length, int barrier_length, const msa_config& config) {
+    /*
+     * Align integer token ids (such as vocabulary ids) instead of strings, the input is read in place and no token is
+     * converted to string. The segmentation and the alignment of segments are the same as align_segment,
+     * except that tokens are partially matched by is_partial_match instead of edit distance, and nothing is printed.
+     *
+     * @param is_partial_match: decide if two different token ids are partially matched, empty for no partial match
+     * @return: see align_token_id_with_table
+     */
+    return align_token_id_with_table(hypothesis, reference, reference_label, [&](const std::vector<std::vector<uint32_t>>& token_id_sequence) {
+        return get_score_table(token_id_sequence, is_partial_match);
+    }, segment_length, barrier_length, config);
+}
+
+token_id_alignment align_token_index(const std::vector<std::string>& hypothesis, const std::vector<std::string>& reference, const std::vector<std::string>& reference_label,
+                                     int partial_bound, int segment_length, int barrier_length, const msa_config& config) {
+    /*
+     * Align tokens and give the index of each aligned token in the original hypothesis or reference instead of the token,
+     * the result is the same as align_with_auto_segment, align_with_manual_segment or align_without_segment
+     * with the same segmentation, and nothing is printed.
+     *
+     * The speaker labels are interned in sorted order, so the speaker ids are the indexes in get_unique_speaker_label.
+     *
+     * @return: see align_token_id_with_table, the speaker ids are the indexes in the unique speaker labels
+     */
+    stage_timer total_timer(config.stats, &alignment_stats::total_nanosecond);
+    stage_timer intern_timer(config.stats, &alignment_stats::stitch_nanosecond);
+    interned_input input = intern_input(hypothesis, reference, reference_label);
+    intern_timer.stop();
+    std::vector<std::vector<int>> segment_index = get_token_id_segment_index(input.hypothesis_id, input.reference_id, segment_length, barrier_length, config);
+    token_id_alignment result = align_token_id_segment(input.hypothesis_id, input.reference_id, input.label_index.label_id, input.label_index.unique_speaker_label.size(),
+                                                       segment_index, get_interned_score_table(input, partial_bound), config);
+    stage_timer gap_column_timer(config.stats, &alignment_stats::stitch_nanosecond);
+    result.speaker_id.resize(input.label_index.unique_speaker_label.size());
+    std::iota(result.speaker_id.begin(), result.speaker_id.end(), 0);
+
+    // a token equal to GAP looks like a gap in the aligned tokens, so its column is a gap as in get_token_match_result
+    for (int c = 0; c < result.column_match.size(); ++c) {
+        for (int s = 0; s < result.align_index.size(); ++s) {
+            int position = result.align_index[s][c];
+            if (position != -1 && (s == 0 ? input.hypothesis_id[position] : input.reference_id[position]) == GAP_ID) {
+                result.column_match[c] = token_match_type::gap;
+            }
+        }
+    }
+    return result;
+}
+
+token_id_alignment align_token_id_with_table(std::span<const uint32_t> hypothesis, std::span<const uint32_t> reference, std::span<const uint32_t> reference_label,
+                                             const score_table_function& get_table, int segment_length, int barrier_length, const msa_config& config) {
+    /*
+     * Align token ids with the segmentation selected by segment length and barrier length, the scores of each segment
+     * are given by get_table, the speakers are sorted by speaker id.
+     *
+     * @param hypothesis: hypothesis token ids
+     * @param reference: reference token ids
+     * @param reference_label: speaker id of each reference token
+     * @param get_table: score table of the token ids of the hypothesis and separated references of a segment
+     * @param segment_length: SEGMENT_AUTO (with barrier_length SEGMENT_AUTO) for automatic segmentation,
+     * positive (with positive barrier_length) for manual segmentation, otherwise no segmentation
+     * @param barrier_length: SEGMENT_AUTO or the barrier length of manual segmentation
+     * @param config: options of the alignment engine
+     * @return: unique speaker ids and the aligned index of the hypothesis and the reference of each speaker
+     */
+    stage_timer total_timer(config.stats, &alignment_stats::total_nanosecond);
+    // map speaker ids to dense ids in ascending order of speaker id, the dense ids are the indexes in result.speaker_id
+    stage_timer label_timer(config.stats, &alignment_stats::stitch_nanosecond);
+    basic_speaker_label_index<uint32_t> label_index = get_speaker_label_index(reference_label);
+    label_timer.stop();
+    std::vector<std::vector<int>> segment_index = get_token_id_segment_index(hypothesis, reference, segment_length, barrier_length, config);
+    token_id_alignment result = align_token_id_segment(hypothesis, reference, label_index.label_id, label_index.unique_speaker_label.size(), segment_index, get_table, config);
+    result.speaker_id = std::move(label_index.unique_speaker_label);
+    return result;
 }
 
-std::vector<std::vector<std::string>> align_from_csv(const std::string& input_file, int hypo_line, int ref_line, int ref_label_line, int partial_bound) {
-    std::vector<std::vector<std::string>> content = read_csv(input_file);
-    std::vector<std::string> hypothesis = get_total_hypothesis(content, hypo_line);
-    std::vector<std::vector<std::string>> reference_with_label = get_total_reference_with_label(content, ref_line, ref_label_line);
-    std::vector<std::string> reference = reference_with_label[0];
-    std::vector<std::string> reference_label = reference_with_label[1];
-    std::vector<std::vector<std::string>> align_result = align_with_auto_segment(hypothesis, reference, reference_label, partial_bound);
+std::vector<std::vector<std::string>> align_from_csv(const std::string& input_file, int hypo_line, int ref_line, int ref_label_line, int partial_bound, const msa_config& config) {
+    // only the rows used by the alignment are read from the mapped file
+    csv_file file(input_file);
+    std::vector<std::string> hypothesis = file.get_row(hypo_line);
+    std::vector<std::string> reference = file.get_row(ref_line);
+    std::vector<std::string> reference_label = file.get_row(ref_label_line);
+    std::vector<std::vector<std::string>> align_result = align_with_auto_segment(hypothesis, reference, reference_label, partial_bound, config);
     return align_result;
 }
 
@@ -133,12 +510,9 @@ int main() {
 //    auto unique_speaker_label = get_unique_speaker_label(reference_label);
 //    auto aligned_hypo_speaker_label = get_aligned_hypo_speaker_label(result, content[1]);
 //
-//    write_csv_multiple_line<std::vector<std::vector<std::string>>>("../data/example_output3.csv", result);
-//    write_csv_single_line<std::vector<std::string>>("../data/example_output3.csv", token_match_result);
-//    write_csv_multiple_line<std::vector<std::vector<int>>>("../data/example_output3.csv", align_indexes);
-//    write_csv_multiple_line("../data/example_output3.csv", ref_original_index);
-//    write_csv_single_line("../data/example_output3.csv", unique_speaker_label);
-//    write_csv_single_line("../data/example_output3.csv", aligned_hypo_speaker_label);
+//    result_writer writer("../data/example_output3.csv");
+//    writer.write_result(result, token_match_result, align_indexes, ref_original_index, unique_speaker_label, aligned_hypo_speaker_label);
+//    writer.close();
 
 
 //    std::vector<std::string> hypo{"ok", "I", "am", "a", "fish", "Are", "you", "Hello", "there", "How", "are", "you", "ok"};
@@ -1,15 +1,98 @@
 #ifndef MSA_ALIGN_H
 #define MSA_ALIGN_H
 
+#include <cstdint>
+#include <functional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
-std::vector<std::vector<std::string>> align_without_segment(const std::vector<std::string>&, const std::vector<std::string>&, const std::vector<std::string>&, int = 2);
+#include "msa.h"
+#include "preprocess.h"
 
-std::vector<std::vector<std::string>> align_with_auto_segment(const std::vector<std::string>&, const std::vector<std::string>&, const std::vector<std::string>&, int = 2);
+#define SEGMENT_AUTO (-1)
 
-std::vector<std::vector<std::string>> align_with_manual_segment(const std::vector<std::string>&, const std::vector<std::string>&, const std::vector<std::string>&, int, int, int = 2);
+struct alignment_job {
+    /*
+     * Input of one alignment in align_batch
+     */
+    std::vector<std::string> hypothesis;
+    std::vector<std::string> reference;
+    std::vector<std::string> reference_label;
+    int segment_length{0};  // SEGMENT_AUTO (with barrier_length SEGMENT_AUTO) for automatic segmentation, positive for manual segmentation, otherwise no segmentation
+    int barrier_length{0};
+};
 
-std::vector<std::vector<std::string>> align_from_csv(const std::string&, int, int, int, int = 2);
+struct segment_cost {
+    /*
+     * Range and predicted cost of a segment from estimate_alignment_cost
+     */
+    int hypothesis_start;
+    int hypothesis_end;
+    int reference_start;
+    int reference_end;
+    alignment_cost cost;
+    bool within_budget{true};  // if the segment fits in max_memory_bytes of the config
+};
+
+struct token_id_alignment {
+    /*
+     * Result of align_token_id
+     */
+    std::vector<uint32_t> speaker_id;           // unique speaker ids in ascending order, one for each reference row
+    std::vector<std::vector<int>> align_index;  // hypothesis row and one row per speaker, index of the token in the original hypothesis
+                                                // or the original (combined) reference, -1 represents a gap
+    std::vector<token_match_type> column_match;  // match type of each aligned column decided by the alignment
+};
+
+struct interned_input {
+    /*
+     * Tokens and speaker labels of string input interned once by intern_input
+     */
+    std::vector<std::string_view> vocabulary;   // mapping from token id to token, the views point into the input
+    std::vector<uint32_t> hypothesis_id;
+    std::vector<uint32_t> reference_id;
+    speaker_label_index label_index;
+};
+
+// score table of the token ids of the hypothesis and separated references of a segment
+typedef std::function<score_table(const std::vector<std::vector<uint32_t>>&)> score_table_function;
+
+msa_config get_segment_config(const msa_config&, size_t);
+
+interned_input intern_input(const std::vector<std::string>&, const std::vector<std::string>&, const std::vector<std::string>&);
+
+score_table_function get_interned_score_table(const interned_input&, int);
+
+std::vector<std::vector<int>> get_token_id_segment_index(std::span<const uint32_t>, std::span<const uint32_t>, int, int, const msa_config& = {});
+
+token_id_alignment align_token_id_segment(std::span<const uint32_t>, std::span<const uint32_t>, std::span<const uint32_t>, size_t, const std::vector<std::vector<int>>&, const score_table_function&, const msa_config& = {});
+
+std::vector<std::vector<std::string>> get_align_token(const token_id_alignment&, const std::vector<std::string>&, const std::vector<std::string>&);
+
+std::vector<std::vector<std::string>> align_segment(const std::vector<std::string>&, const std::vector<std::string>&, const std::vector<std::string>&, const std::vector<std::vector<int>>&, int = 2, const msa_config& = {});
+
+std::vector<std::vector<std::string>> align_with_segment(const std::vector<std::string>&, const std::vector<std::string>&, const std::vector<std::string>&, int, int, int = 2, const msa_config& = {});
+
+std::vector<std::vector<std::string>> align_without_segment(const std::vector<std::string>&, const std::vector<std::string>&, const std::vector<std::string>&, int = 2, const msa_config& = {});
+
+std::vector<std::vector<std::string>> align_with_auto_segment(const std::vector<std::string>&, const std::vector<std::string>&, const std::vector<std::string>&, int = 2, const msa_config& = {});
+
+std::vector<std::vector<std::string>> align_with_manual_segment(const std::vector<std::string>&, const std::vector<std::string>&, const std::vector<std::string>&, int, int, int = 2, const msa_config& = {});
+
+std::vector<segment_cost> estimate_alignment_cost(const std::vector<std::string>&, const std::vector<std::string>&, const std::vector<std::string>&, int = 0, int = 0, const msa_config& = {});
+
+std::vector<std::vector<std::string>> align_job(const alignment_job&, int = 2, const msa_config& = {});
+
+std::vector<std::vector<std::vector<std::string>>> align_batch(const std::vector<alignment_job>&, int = 2, const msa_config& = {});
+
+token_id_alignment align_token_id(std::span<const uint32_t>, std::span<const uint32_t>, std::span<const uint32_t>, const partial_match_function& = {}, int = 0, int = 0, const msa_config& = {});
+
+token_id_alignment align_token_index(const std::vector<std::string>&, const std::vector<std::string>&, const std::vector<std::string>&, int = 2, int = 0, int = 0, const msa_config& = {});
+
+token_id_alignment align_token_id_with_table(std::span<const uint32_t>, std::span<const uint32_t>, std::span<const uint32_t>, const score_table_function&, int = 0, int = 0, const msa_config& = {});
+
+std::vector<std::vector<std::string>> align_from_csv(const std::string&, int, int, int, int = 2, const msa_config& = {});
 
 #endif //MSA_ALIGN_H
@@ -1,27 +1,65 @@
 #define PY_SSIZE_T_CLEAN
 #include "Python.h"
 
+#include <bit>
 #include <chrono>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_set>
 #include <vector>
 
 #include "preprocess.h"
 #include "msa.h"
 #include "postprocess.h"
 #include "align.h"
+#include "stream.h"
 
-std::vector<std::string> string_list_to_vector(PyObject *py_list) {
+#if PY_VERSION_HEX < 0x030D0000
+// free-threaded builds start from python 3.13, before it the GIL already keeps a list unchanged while it is read
+static PyObject *PyList_GetItemRef(PyObject *py_list, Py_ssize_t i) {
+    PyObject *item = PyList_GetItem(py_list, i);
+    Py_XINCREF(item);
+    return item;
+}
+#define Py_BEGIN_CRITICAL_SECTION(op) {
+#define Py_END_CRITICAL_SECTION() }
+#endif
+
+bool string_list_to_vector(PyObject *py_list, std::vector<std::string>& string_vector) {
     /*
-     * Parse python list of strings to c++ vector of strings
+     * Parse python list of strings to c++ vector of strings, the list is locked while it is read,
+     * so that another thread can not change it on free-threaded python
+     *
+     * @return: false with a python exception set if it is not a list of strings
      */
-    long long size = PyList_Size(py_list);
-    std::vector<std::string> string_vector;
-    for (int i = 0; i < size; ++i) {
-        PyObject *py_string = PyList_GetItem(py_list, i);
-        const char *token = PyUnicode_AsUTF8(py_string);
+    if (!PyList_Check(py_list)) {
+        PyErr_SetString(PyExc_TypeError, "expected a list of strings");
+        return false;
+    }
+    bool is_valid{true};
+    string_vector.clear();
+    Py_BEGIN_CRITICAL_SECTION(py_list);
+    Py_ssize_t size = PyList_GET_SIZE(py_list);
+    string_vector.reserve(size);
+    for (Py_ssize_t i = 0; i < size; ++i) {
+        PyObject *py_string = PyList_GET_ITEM(py_list, i);
+        const char *token = PyUnicode_Check(py_string) ? PyUnicode_AsUTF8(py_string) : nullptr;
+        if (!token) {
+            if (!PyErr_Occurred()) {
+                PyErr_Format(PyExc_TypeError, "expected a list of strings, got %s at index %zd", Py_TYPE(py_string)->tp_name, i);
+            }
+            is_valid = false;
+            break;
+        }
         string_vector.emplace_back(token);
     }
-    return string_vector;
+    Py_END_CRITICAL_SECTION();
+    return is_valid;
 }
 
 PyObject *string_vector_to_list(const std::vector<std::string> &string_vector) {
@@ -70,15 +108,27 @@ PyObject *int_vector_to_list(const std::vector<int>& int_vector) {
     return py_list;
 }
 
-std::vector<std::vector<std::string>> nested_str_list_to_vector(PyObject *py_list) {
-    std::vector<std::vector<std::string>> result;
-    long long size = PyList_Size(py_list);
-    for (int i = 0; i < size; ++i) {
-        PyObject *string_list = PyList_GetItem(py_list, i);
-        std::vector<std::string> string_vector = string_list_to_vector(string_list);
-        result.emplace_back(string_vector);
+bool nested_str_list_to_vector(PyObject *py_list, std::vector<std::vector<std::string>>& result) {
+    /*
+     * Parse python list of lists of strings, each inner list is held by a strong reference while it is read
+     *
+     * @return: false with a python exception set if it is not a list of lists of strings
+     */
+    result.clear();
+    for (Py_ssize_t i = 0; i < PyList_Size(py_list); ++i) {
+        PyObject *string_list = PyList_GetItemRef(py_list, i);
+        if (!string_list) {
+            return false;
+        }
+        std::vector<std::string> string_vector;
+        bool is_valid = string_list_to_vector(string_list, string_vector);
+        Py_DECREF(string_list);
+        if (!is_valid) {
+            return false;
+        }
+        result.emplace_back(std::move(string_vector));
     }
-    return result;
+    return true;
 }
 
 PyObject *nested_str_vector_to_list(const std::vector<std::vector<std::string>> &sequences) {
@@ -119,65 +169,844 @@ PyObject *nested_int_vector_to_list(const std::vector<std::vector<int>> &align_i
     return py_list;
 }
 
-static PyObject *align_without_segment(PyObject *self, PyObject *args) {
+PyObject *index_vector_to_bytes_list(const std::vector<std::vector<int>> &align_index) {
+    /*
+     * Parse c++ aligned index to python list with a bytes object of native int32 for each sequence,
+     * which can be read without creating an object per token, e.g. numpy.frombuffer(row, dtype=numpy.int32)
+     */
+    static_assert(sizeof(int) == sizeof(int32_t));
+    PyObject *py_list = PyList_New(align_index.size());
+    if (!py_list) {
+        return NULL;
+    }
+    for (int i = 0; i < align_index.size(); ++i) {
+        PyObject *py_bytes = PyBytes_FromStringAndSize((const char *)align_index[i].data(), (Py_ssize_t)(align_index[i].size() * sizeof(int32_t)));
+        if (!py_bytes) {
+            Py_DECREF(py_list);
+            return NULL;
+        }
+        PyList_SET_ITEM(py_list, i, py_bytes);
+    }
+    return py_list;
+}
+
+bool set_msa_config(const char *engine, int store_traceback, Py_ssize_t max_memory_bytes, msa_config& config) {
+    /*
+     * Set the options of the alignment engine parsed from python keywords, set a python ValueError for an invalid option
+     */
+    if (engine == nullptr || std::string(engine) == "dense") {
+        config.engine = msa_engine::dense;
+    } else if (std::string(engine) == "linear_memory") {
+        config.engine = msa_engine::linear_memory;
+    } else if (std::string(engine) == "astar") {
+        config.engine = msa_engine::astar;
+    } else if (std::string(engine) == "progressive") {
+        config.engine = msa_engine::progressive;
+    } else {
+        PyErr_Format(PyExc_ValueError, "unknown alignment engine: %s", engine);
+        return false;
+    }
+    if (max_memory_bytes < 0) {
+        PyErr_SetString(PyExc_ValueError, "max_memory_bytes must be non-negative");
+        return false;
+    }
+    config.store_traceback = store_traceback;
+    config.max_memory_bytes = (size_t)max_memory_bytes;
+    return true;
+}
+
+const char *get_engine_name(msa_engine engine) {
+    switch (engine) {
+        case msa_engine::linear_memory:
+            return "linear_memory";
+        case msa_engine::astar:
+            return "astar";
+        case msa_engine::progressive:
+            return "progressive";
+        default:
+            return "dense";
+    }
+}
+
+bool set_alignment_stats(PyObject *py_stats, alignment_stats& stats, msa_config& config) {
+    /*
+     * Fill the stats of the alignment when a dict is given by the stats keyword, set a python TypeError for other objects except None
+     */
+    if (py_stats == NULL || py_stats == Py_None) {
+        return true;
+    }
+    if (!PyDict_Check(py_stats)) {
+        PyErr_SetString(PyExc_TypeError, "stats must be a dict or None");
+        return false;
+    }
+    config.stats = &stats;
+    return true;
+}
+
+bool update_stats_dict(PyObject *py_stats, const alignment_stats& stats) {
+    /*
+     * Put the time of each stage (in nanoseconds) and the counters of the alignment into the dict given by the stats keyword
+     */
+    if (py_stats == NULL || py_stats == Py_None) {
+        return true;
+    }
+    std::pair<const char *, long long> item[] = {
+            {"segmentation_nanosecond", stats.segmentation_nanosecond},
+            {"parameter_search_nanosecond", stats.parameter_search_nanosecond},
+            {"score_table_nanosecond", stats.score_table_nanosecond},
+            {"fill_nanosecond", stats.fill_nanosecond},
+            {"traceback_nanosecond", stats.traceback_nanosecond},
+            {"stitch_nanosecond", stats.stitch_nanosecond},
+            {"exact_check_nanosecond", stats.exact_check_nanosecond},
+            {"total_nanosecond", stats.total_nanosecond},
+            {"segment_num", (long long)stats.segment_num},
+            {"cell", (long long)stats.cell},
+            {"compare_call", (long long)stats.compare_call},
+            {"edit_distance_call", (long long)stats.edit_distance_call},
+            {"peak_tensor_byte", (long long)stats.peak_tensor_byte},
+            {"exact_check_segment", (long long)stats.exact_check_segment},
+            {"score_gap", stats.score_gap},
+            {"band_limited_segment", (long long)stats.band_limited_segment},
+            {"band_width", stats.band_width},
+    };
+    for (const auto& [key, value]: item) {
+        PyObject *py_value = PyLong_FromLongLong(value);
+        if (!py_value || PyDict_SetItemString(py_stats, key, py_value) != 0) {
+            Py_XDECREF(py_value);
+            return false;
+        }
+        Py_DECREF(py_value);
+    }
+    PyObject *py_segment_nanosecond = PyList_New(stats.segment_nanosecond.size());
+    if (!py_segment_nanosecond) {
+        return false;
+    }
+    for (int i = 0; i < stats.segment_nanosecond.size(); ++i) {
+        PyObject *py_value = PyLong_FromLongLong(stats.segment_nanosecond[i]);
+        if (!py_value) {
+            Py_DECREF(py_segment_nanosecond);
+            return false;
+        }
+        PyList_SET_ITEM(py_segment_nanosecond, i, py_value);
+    }
+    int status = PyDict_SetItemString(py_stats, "segment_nanosecond", py_segment_nanosecond);
+    Py_DECREF(py_segment_nanosecond);
+    return status == 0;
+}
+
+void set_python_error(std::exception_ptr error) {
+    /*
+     * Translate a c++ exception to a python exception, MemoryError for memory budget and allocation failures,
+     * ValueError for invalid arguments
+     */
+    try {
+        std::rethrow_exception(error);
+    } catch (const memory_budget_error& e) {
+        PyErr_SetString(PyExc_MemoryError, e.what());
+    } catch (const std::bad_alloc&) {
+        PyErr_NoMemory();
+    } catch (const std::invalid_argument& e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    } catch (const std::exception& e) {
+        PyErr_SetString(PyExc_RuntimeError, e.what());
+    } catch (...) {
+        PyErr_SetString(PyExc_RuntimeError, "unknown c++ exception");
+    }
+}
+
+template <typename F>
+bool run_without_gil(F&& compute) {
+    /*
+     * Run pure c++ computation with the GIL released so that other python threads keep running during the alignment,
+     * no python object can be used inside, the c++ exception is translated to python exception after the GIL is acquired again
+     *
+     * @param compute: function without python objects
+     * @return: false if an exception is raised and the python error is set
+     */
+    std::exception_ptr error;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        compute();
+    } catch (...) {
+        error = std::current_exception();
+    }
+    Py_END_ALLOW_THREADS
+    if (error) {
+        set_python_error(error);
+        return false;
+    }
+    return true;
+}
+
+struct int32_buffer {
+    /*
+     * One dimensional int32 array (NumPy array, array.array, ...) read in place through the buffer protocol,
+     * the buffer is released when the object goes out of scope
+     */
+    Py_buffer view{};
+    bool is_acquired{false};
+
+    ~int32_buffer() {
+        if (is_acquired) {
+            PyBuffer_Release(&view);
+        }
+    }
+
+    std::span<const uint32_t> get() const {
+        return {(const uint32_t *)view.buf, (size_t)(view.len / sizeof(uint32_t))};
+    }
+};
+
+bool get_int32_buffer(PyObject *object, const char *name, int32_buffer& buffer) {
+    /*
+     * Get a contiguous int32 buffer of non-negative ids from a python object, set a python error if it is not one,
+     * an unsigned 32-bit buffer is accepted as long as every id fits in int32
+     */
+    if (PyObject_GetBuffer(object, &buffer.view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0) {
+        PyErr_Clear();
+        PyErr_Format(PyExc_TypeError, "%s must support the buffer protocol", name);
+        return false;
+    }
+    buffer.is_acquired = true;
+    std::string_view format = buffer.view.format ? buffer.view.format : "B";
+    if (!format.empty() && (format[0] == '@' || format[0] == '=' || (format[0] == '<' && std::endian::native == std::endian::little))) {
+        format.remove_prefix(1);
+    }
+    if (buffer.view.itemsize != sizeof(int32_t) || format.size() != 1 || std::string_view("iIlL").find(format[0]) == std::string_view::npos) {
+        PyErr_Format(PyExc_TypeError, "%s must be an array of int32", name);
+        return false;
+    }
+    // a negative int32 is a uint32 above INT32_MAX when the array is unsigned
+    bool is_unsigned = format[0] == 'I' || format[0] == 'L';
+    const int32_t *id = (const int32_t *)buffer.view.buf;
+    for (Py_ssize_t i = 0; i < buffer.view.len / (Py_ssize_t)sizeof(int32_t); ++i) {
+        if (id[i] < 0) {
+            if (is_unsigned) {
+                PyErr_Format(PyExc_ValueError, "%s has an id %u that exceeds int32", name, (uint32_t)id[i]);
+            } else {
+                PyErr_Format(PyExc_ValueError, "%s must be non-negative", name);
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+struct python_partial_match {
+    /*
+     * Python callable deciding partial matches of token ids, the GIL is acquired for each call,
+     * the first exception raised by the callable is kept and restored after the alignment,
+     * the GIL does not serialize the segments on free-threaded builds, so the first exception is kept under error_mutex
+     */
+    PyObject *callback{nullptr};
+    PyObject *error_type{nullptr};
+    PyObject *error_value{nullptr};
+    PyObject *error_traceback{nullptr};
+    std::mutex error_mutex;
+
+    bool operator()(uint32_t hypothesis, uint32_t reference) {
+        PyGILState_STATE state = PyGILState_Ensure();
+        PyObject *py_result = PyObject_CallFunction(callback, "II", hypothesis, reference);
+        int is_match = py_result ? PyObject_IsTrue(py_result) : -1;
+        Py_XDECREF(py_result);
+        if (is_match < 0) {
+            std::lock_guard<std::mutex> guard(error_mutex);
+            if (!error_type) {
+                PyErr_Fetch(&error_type, &error_value, &error_traceback);
+            } else {
+                PyErr_Clear();
+            }
+        }
+        PyGILState_Release(state);
+        if (is_match < 0) {
+            throw std::runtime_error("partial_match raised an exception");
+        }
+        return is_match;
+    }
+
+    bool restore_error() {
+        std::lock_guard<std::mutex> guard(error_mutex);
+        if (!error_type) {
+            return false;
+        }
+        PyErr_Restore(error_type, error_value, error_traceback);
+        error_type = error_value = error_traceback = nullptr;
+        return true;
+    }
+};
+
+bool get_partial_match_function(PyObject *py_partial_match, python_partial_match& callback, std::unordered_set<uint64_t>& pair_set, partial_match_function& is_partial_match) {
+    /*
+     * Get the partial match decision of integer token input from python, which is None (no partial match),
+     * a callable taking a hypothesis id and a reference id, or an int32 array of (id, id) pairs matched in both orders
+     */
+    if (py_partial_match == nullptr || py_partial_match == Py_None) {
+        is_partial_match = nullptr;
+    } else if (PyCallable_Check(py_partial_match)) {
+        callback.callback = py_partial_match;
+        is_partial_match = [&callback](uint32_t hypothesis, uint32_t reference) { return callback(hypothesis, reference); };
+    } else {
+        int32_buffer pair_buffer;
+        if (!get_int32_buffer(py_partial_match, "partial_match", pair_buffer)) {
+            return false;
+        }
+        std::span<const uint32_t> pair = pair_buffer.get();
+        if (pair.size() % 2 != 0) {
+            PyErr_SetString(PyExc_ValueError, "partial_match must be pairs of token ids");
+            return false;
+        }
+        for (size_t i = 0; i < pair.size(); i += 2) {
+            pair_set.emplace(((uint64_t)pair[i] << 32) | pair[i + 1]);
+            pair_set.emplace(((uint64_t)pair[i + 1] << 32) | pair[i]);
+        }
+        is_partial_match = [&pair_set](uint32_t hypothesis, uint32_t reference) { return pair_set.contains(((uint64_t)hypothesis << 32) | reference); };
+    }
+    return true;
+}
+
+static PyObject *align_without_segment(PyObject *self, PyObject *args, PyObject *kwargs) {
     PyObject *hypothesis_list;
     PyObject *reference_list;
     PyObject *reference_label_list;
     int partial_bound = 2;
+    msa_config config;
+    const char *engine = nullptr;
+    int store_traceback = 0;
+    Py_ssize_t max_memory_bytes = 0;
+    PyObject *py_stats = NULL;
+    alignment_stats stats;
+    static const char *kwlist[] = {"hypothesis", "reference", "reference_label", "partial_bound", "thread_num", "band_width", "engine", "store_traceback", "max_memory_bytes", "stats", NULL};
 
-    if (!PyArg_ParseTuple(args, "O!O!O!|i", &PyList_Type, &hypothesis_list, &PyList_Type, &reference_list, &PyList_Type, &reference_label_list, &partial_bound)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O!O!|iiispnO", (char **)kwlist, &PyList_Type, &hypothesis_list, &PyList_Type, &reference_list, &PyList_Type, &reference_label_list, &partial_bound, &config.thread_num, &config.band_width, &engine, &store_traceback, &max_memory_bytes, &py_stats)) {
+        return NULL;
+    }
+    if (!set_msa_config(engine, store_traceback, max_memory_bytes, config)) {
+        return NULL;
+    }
+    if (!set_alignment_stats(py_stats, stats, config)) {
         return NULL;
     }
 
-    std::vector<std::string> hypothesis = string_list_to_vector(hypothesis_list);
-    std::vector<std::string> reference = string_list_to_vector(reference_list);
-    std::vector<std::string> reference_label = string_list_to_vector(reference_label_list);
+    std::vector<std::string> hypothesis, reference, reference_label;
+    if (!string_list_to_vector(hypothesis_list, hypothesis) || !string_list_to_vector(reference_list, reference)
+        || !string_list_to_vector(reference_label_list, reference_label)) {
+        return NULL;
+    }
 
-    std::vector<std::vector<std::string>> align_result = align_without_segment(hypothesis, reference, reference_label, partial_bound);
+    std::vector<std::vector<std::string>> align_result;
+    if (!run_without_gil([&]() { align_result = align_without_segment(hypothesis, reference, reference_label, partial_bound, config); })) {
+        return NULL;
+    }
+    if (!update_stats_dict(py_stats, stats)) {
+        return NULL;
+    }
     PyObject *py_align_result = nested_str_vector_to_list(align_result);
     return Py_BuildValue("O", py_align_result);
 }
 
-static PyObject *align_with_auto_segment(PyObject *self, PyObject *args) {
+static PyObject *align_with_auto_segment(PyObject *self, PyObject *args, PyObject *kwargs) {
     PyObject *hypothesis_list;
     PyObject *reference_list;
     PyObject *reference_label_list;
     int partial_bound = 2;
+    msa_config config;
+    const char *engine = nullptr;
+    int store_traceback = 0;
+    Py_ssize_t max_memory_bytes = 0;
+    PyObject *py_stats = NULL;
+    alignment_stats stats;
+    static const char *kwlist[] = {"hypothesis", "reference", "reference_label", "partial_bound", "thread_num", "band_width", "engine", "store_traceback", "max_memory_bytes", "stats", NULL};
 
-    if (!PyArg_ParseTuple(args, "O!O!O!|i", &PyList_Type, &hypothesis_list, &PyList_Type, &reference_list, &PyList_Type, &reference_label_list, &partial_bound)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O!O!|iiispnO", (char **)kwlist, &PyList_Type, &hypothesis_list, &PyList_Type, &reference_list, &PyList_Type, &reference_label_list, &partial_bound, &config.thread_num, &config.band_width, &engine, &store_traceback, &max_memory_bytes, &py_stats)) {
+        return NULL;
+    }
+    if (!set_msa_config(engine, store_traceback, max_memory_bytes, config)) {
+        return NULL;
+    }
+    if (!set_alignment_stats(py_stats, stats, config)) {
         return NULL;
     }
 
-    std::vector<std::string> hypothesis = string_list_to_vector(hypothesis_list);
-    std::vector<std::string> reference = string_list_to_vector(reference_list);
-    std::vector<std::string> reference_label = string_list_to_vector(reference_label_list);
+    std::vector<std::string> hypothesis, reference, reference_label;
+    if (!string_list_to_vector(hypothesis_list, hypothesis) || !string_list_to_vector(reference_list, reference)
+        || !string_list_to_vector(reference_label_list, reference_label)) {
+        return NULL;
+    }
 
-    std::vector<std::vector<std::string>> align_result = align_with_auto_segment(hypothesis, reference, reference_label, partial_bound);
+    std::vector<std::vector<std::string>> align_result;
+    if (!run_without_gil([&]() { align_result = align_with_auto_segment(hypothesis, reference, reference_label, partial_bound, config); })) {
+        return NULL;
+    }
+    if (!update_stats_dict(py_stats, stats)) {
+        return NULL;
+    }
     PyObject *py_align_result = nested_str_vector_to_list(align_result);
     return Py_BuildValue("O", py_align_result);
 }
 
-static PyObject *align_with_manual_segment(PyObject *self, PyObject *args) {
+static PyObject *align_with_manual_segment(PyObject *self, PyObject *args, PyObject *kwargs) {
     PyObject *hypothesis_list;
     PyObject *reference_list;
     PyObject *reference_label_list;
     int segment_length = 0;
     int barrier_length = 0;
     int partial_bound = 2;
+    msa_config config;
+    const char *engine = nullptr;
+    int store_traceback = 0;
+    Py_ssize_t max_memory_bytes = 0;
+    PyObject *py_stats = NULL;
+    alignment_stats stats;
+    static const char *kwlist[] = {"hypothesis", "reference", "reference_label", "segment_length", "barrier_length", "partial_bound", "thread_num", "band_width", "engine", "store_traceback", "max_memory_bytes", "stats", NULL};
 
-    if (!PyArg_ParseTuple(args, "O!O!O!ii|i", &PyList_Type, &hypothesis_list, &PyList_Type, &reference_list, &PyList_Type, &reference_label_list, &segment_length, &barrier_length, &partial_bound)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O!O!ii|iiispnO", (char **)kwlist, &PyList_Type, &hypothesis_list, &PyList_Type, &reference_list, &PyList_Type, &reference_label_list, &segment_length, &barrier_length, &partial_bound, &config.thread_num, &config.band_width, &engine, &store_traceback, &max_memory_bytes, &py_stats)) {
+        return NULL;
+    }
+    if (!set_msa_config(engine, store_traceback, max_memory_bytes, config)) {
+        return NULL;
+    }
+    if (!set_alignment_stats(py_stats, stats, config)) {
         return NULL;
     }
 
-    std::vector<std::string> hypothesis = string_list_to_vector(hypothesis_list);
-    std::vector<std::string> reference = string_list_to_vector(reference_list);
-    std::vector<std::string> reference_label = string_list_to_vector(reference_label_list);
+    std::vector<std::string> hypothesis, reference, reference_label;
+    if (!string_list_to_vector(hypothesis_list, hypothesis) || !string_list_to_vector(reference_list, reference)
+        || !string_list_to_vector(reference_label_list, reference_label)) {
+        return NULL;
+    }
 
-    std::vector<std::vector<std::string>> align_result = align_with_manual_segment(hypothesis, reference, reference_label, segment_length, barrier_length, partial_bound);
+    std::vector<std::vector<std::string>> align_result;
+    if (!run_without_gil([&]() { align_result = align_with_manual_segment(hypothesis, reference, reference_label, segment_length, barrier_length, partial_bound, config); })) {
+        return NULL;
+    }
+    if (!update_stats_dict(py_stats, stats)) {
+        return NULL;
+    }
     PyObject *py_align_result = nested_str_vector_to_list(align_result);
     return Py_BuildValue("O", py_align_result);
 }
 
+static PyObject *align_batch(PyObject *self, PyObject *args, PyObject *kwargs) {
+    PyObject *job_list;
+    int partial_bound = 2;
+    msa_config config;
+    config.thread_num = 0;
+    const char *engine = nullptr;
+    int store_traceback = 0;
+    Py_ssize_t max_memory_bytes = 0;
+    PyObject *py_stats = NULL;
+    alignment_stats stats;
+    static const char *kwlist[] = {"job", "partial_bound", "thread_num", "band_width", "engine", "store_traceback", "max_memory_bytes", "stats", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!|iiispnO", (char **)kwlist, &PyList_Type, &job_list, &partial_bound, &config.thread_num, &config.band_width, &engine, &store_traceback, &max_memory_bytes, &py_stats)) {
+        return NULL;
+    }
+    if (!set_msa_config(engine, store_traceback, max_memory_bytes, config)) {
+        return NULL;
+    }
+    if (!set_alignment_stats(py_stats, stats, config)) {
+        return NULL;
+    }
+
+    // each job is (hypothesis, reference, reference_label) or (hypothesis, reference, reference_label, segment_length, barrier_length)
+    std::vector<alignment_job> jobs;
+    for (Py_ssize_t i = 0; i < PyList_Size(job_list); ++i) {
+        // the job is held by a strong reference, another thread may remove it from the list on free-threaded python
+        PyObject *py_job = PyList_GetItemRef(job_list, i);
+        if (!py_job) {
+            return NULL;
+        }
+        alignment_job job;
+        PyObject *hypothesis_list, *reference_list, *reference_label_list;
+        if (!PyTuple_Check(py_job) || !PyArg_ParseTuple(py_job, "O!O!O!|ii", &PyList_Type, &hypothesis_list, &PyList_Type, &reference_list, &PyList_Type, &reference_label_list,
+                                                         &job.segment_length, &job.barrier_length)) {
+            Py_DECREF(py_job);
+            PyErr_Clear();
+            PyErr_Format(PyExc_TypeError, "job %zd must be a tuple of (hypothesis, reference, reference_label[, segment_length, barrier_length])", i);
+            return NULL;
+        }
+        bool is_valid = string_list_to_vector(hypothesis_list, job.hypothesis) && string_list_to_vector(reference_list, job.reference)
+                        && string_list_to_vector(reference_label_list, job.reference_label);
+        Py_DECREF(py_job);
+        if (!is_valid) {
+            return NULL;
+        }
+        jobs.emplace_back(std::move(job));
+    }
+
+    std::vector<std::vector<std::vector<std::string>>> result;
+    if (!run_without_gil([&]() { result = align_batch(jobs, partial_bound, config); })) {
+        return NULL;
+    }
+    if (!update_stats_dict(py_stats, stats)) {
+        return NULL;
+    }
+    PyObject *py_result = PyList_New(result.size());
+    if (!py_result) {
+        return NULL;
+    }
+    for (int i = 0; i < result.size(); ++i) {
+        PyObject *py_align_result = nested_str_vector_to_list(result[i]);
+        if (!py_align_result) {
+            Py_DECREF(py_result);
+            return NULL;
+        }
+        PyList_SET_ITEM(py_result, i, py_align_result);
+    }
+    return py_result;
+}
+
+static PyObject *align_index(PyObject *self, PyObject *args, PyObject *kwargs) {
+    PyObject *hypothesis_list;
+    PyObject *reference_list;
+    PyObject *reference_label_list;
+    int partial_bound = 2;
+    int segment_length = 0;
+    int barrier_length = 0;
+    msa_config config;
+    const char *engine = nullptr;
+    int store_traceback = 0;
+    Py_ssize_t max_memory_bytes = 0;
+    PyObject *py_stats = NULL;
+    alignment_stats stats;
+    static const char *kwlist[] = {"hypothesis", "reference", "reference_label", "partial_bound", "segment_length", "barrier_length", "thread_num", "band_width", "engine", "store_traceback", "max_memory_bytes", "stats", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O!O!|iiiiispnO", (char **)kwlist, &PyList_Type, &hypothesis_list, &PyList_Type, &reference_list, &PyList_Type, &reference_label_list,
+                                     &partial_bound, &segment_length, &barrier_length, &config.thread_num, &config.band_width, &engine, &store_traceback, &max_memory_bytes, &py_stats)) {
+        return NULL;
+    }
+    if (!set_msa_config(engine, store_traceback, max_memory_bytes, config)) {
+        return NULL;
+    }
+    if (!set_alignment_stats(py_stats, stats, config)) {
+        return NULL;
+    }
+
+    std::vector<std::string> hypothesis, reference, reference_label;
+    if (!string_list_to_vector(hypothesis_list, hypothesis) || !string_list_to_vector(reference_list, reference)
+        || !string_list_to_vector(reference_label_list, reference_label)) {
+        return NULL;
+    }
+    token_id_alignment result;
+    std::vector<std::string> unique_speaker_label;
+    if (!run_without_gil([&]() {
+        result = align_token_index(hypothesis, reference, reference_label, partial_bound, segment_length, barrier_length, config);
+        unique_speaker_label = get_unique_speaker_label(reference_label);
+    })) {
+        return NULL;
+    }
+    if (!update_stats_dict(py_stats, stats)) {
+        return NULL;
+    }
+    PyObject *py_speaker_label = string_vector_to_list(unique_speaker_label);
+    if (!py_speaker_label) {
+        return NULL;
+    }
+    PyObject *py_align_index = index_vector_to_bytes_list(result.align_index);
+    if (!py_align_index) {
+        Py_DECREF(py_speaker_label);
+        return NULL;
+    }
+    return Py_BuildValue("{s:N,s:N}", "speaker_label", py_speaker_label, "align_index", py_align_index);
+}
+
+PyObject *aligned_token_to_list(const std::vector<int> &align_index, const std::vector<std::string> &token) {
+    /*
+     * Parse c++ aligned index to python list of the aligned tokens, a gap is an empty string shared by all gaps
+     */
+    PyObject *py_list = PyList_New(align_index.size());
+    if (!py_list) {
+        return NULL;
+    }
+    PyObject *py_gap = PyUnicode_FromString("");
+    if (!py_gap) {
+        Py_DECREF(py_list);
+        return NULL;
+    }
+    for (int i = 0; i < align_index.size(); ++i) {
+        PyObject *py_token;
+        if (align_index[i] == -1) {
+            Py_INCREF(py_gap);
+            py_token = py_gap;
+        } else {
+            const std::string& aligned_token = token[align_index[i]];
+            py_token = PyUnicode_FromStringAndSize(aligned_token.data(), (Py_ssize_t)aligned_token.size());
+        }
+        if (!py_token) {
+            Py_DECREF(py_gap);
+            Py_DECREF(py_list);
+            return NULL;
+        }
+        PyList_SET_ITEM(py_list, i, py_token);
+    }
+    Py_DECREF(py_gap);
+    return py_list;
+}
+
+PyObject *list_to_label_dict(const std::vector<std::string> &speaker_label, PyObject *py_list, int offset) {
+    /*
+     * Build python dictionary from speaker label to the item of the list at the same position (after offset), steal py_list
+     */
+    if (!py_list) {
+        return NULL;
+    }
+    PyObject *py_dict = PyDict_New();
+    for (int i = 0; py_dict && i < speaker_label.size(); ++i) {
+        if (PyDict_SetItemString(py_dict, speaker_label[i].c_str(), PyList_GET_ITEM(py_list, i + offset)) < 0) {
+            Py_CLEAR(py_dict);
+        }
+    }
+    Py_DECREF(py_list);
+    return py_dict;
+}
+
+static PyObject *align_artifact(PyObject *self, PyObject *args, PyObject *kwargs) {
+    PyObject *hypothesis_list;
+    PyObject *reference_list;
+    PyObject *reference_label_list;
+    int partial_bound = 2;
+    int segment_length = 0;
+    int barrier_length = 0;
+    PyObject *original_hypothesis_list = NULL;
+    PyObject *original_reference_list = NULL;
+    PyObject *hypothesis_label_list = NULL;
+    msa_config config;
+    const char *engine = nullptr;
+    int store_traceback = 0;
+    Py_ssize_t max_memory_bytes = 0;
+    PyObject *py_stats = NULL;
+    alignment_stats stats;
+    static const char *kwlist[] = {"hypothesis", "reference", "reference_label", "partial_bound", "segment_length", "barrier_length", "original_hypothesis", "original_reference",
+                                   "hypothesis_label", "thread_num", "band_width", "engine", "store_traceback", "max_memory_bytes", "stats", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O!O!|iiiOOOiispnO", (char **)kwlist, &PyList_Type, &hypothesis_list, &PyList_Type, &reference_list, &PyList_Type, &reference_label_list,
+                                     &partial_bound, &segment_length, &barrier_length, &original_hypothesis_list, &original_reference_list,
+                                     &hypothesis_label_list, &config.thread_num, &config.band_width, &engine, &store_traceback, &max_memory_bytes, &py_stats)) {
+        return NULL;
+    }
+    // None is the same as not giving the original tokens or the hypothesis labels
+    for (PyObject **optional_list: {&original_hypothesis_list, &original_reference_list, &hypothesis_label_list}) {
+        if (*optional_list == Py_None) {
+            *optional_list = NULL;
+        } else if (*optional_list && !PyList_Check(*optional_list)) {
+            PyErr_SetString(PyExc_TypeError, "original tokens and hypothesis labels must be lists or None");
+            return NULL;
+        }
+    }
+    if (!set_msa_config(engine, store_traceback, max_memory_bytes, config)) {
+        return NULL;
+    }
+    if (!set_alignment_stats(py_stats, stats, config)) {
+        return NULL;
+    }
+
+    std::vector<std::string> hypothesis, reference, reference_label;
+    if (!string_list_to_vector(hypothesis_list, hypothesis) || !string_list_to_vector(reference_list, reference)
+        || !string_list_to_vector(reference_label_list, reference_label)) {
+        return NULL;
+    }
+    // the aligned tokens are taken from the original tokens (e.g. with punctuation) when they are given
+    std::vector<std::string> original_hypothesis, original_reference, hypothesis_label;
+    if ((original_hypothesis_list && !string_list_to_vector(original_hypothesis_list, original_hypothesis))
+        || (original_reference_list && !string_list_to_vector(original_reference_list, original_reference))
+        || (hypothesis_label_list && !string_list_to_vector(hypothesis_label_list, hypothesis_label))) {
+        return NULL;
+    }
+    if ((original_hypothesis_list && original_hypothesis.size() != hypothesis.size()) || (original_reference_list && original_reference.size() != reference.size())
+        || (hypothesis_label_list && hypothesis_label.size() != hypothesis.size())) {
+        PyErr_SetString(PyExc_ValueError, "original tokens and hypothesis labels must have the same length as the aligned tokens");
+        return NULL;
+    }
+
+    token_id_alignment result;
+    alignment_artifact artifact;
+    std::vector<std::string> unique_speaker_label;
+    if (!run_without_gil([&]() {
+        result = align_token_index(hypothesis, reference, reference_label, partial_bound, segment_length, barrier_length, config);
+        artifact = get_alignment_artifact(result, hypothesis_label);
+        unique_speaker_label = get_unique_speaker_label(reference_label);
+    })) {
+        return NULL;
+    }
+    if (!update_stats_dict(py_stats, stats)) {
+        return NULL;
+    }
+
+    const std::vector<std::string>& hypothesis_token = original_hypothesis_list ? original_hypothesis : hypothesis;
+    const std::vector<std::string>& reference_token = original_reference_list ? original_reference : reference;
+    PyObject *py_output = PyDict_New();
+    if (!py_output) {
+        return NULL;
+    }
+    PyObject *py_reference = PyList_New(result.align_index.size() - 1);
+    for (int i = 1; py_reference && i < result.align_index.size(); ++i) {
+        PyObject *py_row = aligned_token_to_list(result.align_index[i], reference_token);
+        if (!py_row) {
+            Py_CLEAR(py_reference);
+            break;
+        }
+        PyList_SET_ITEM(py_reference, i - 1, py_row);
+    }
+    if (!hypothesis_label_list) {
+        Py_INCREF(Py_None);
+    }
+    std::pair<const char *, PyObject *> item[] = {
+            {"hypothesis",           aligned_token_to_list(result.align_index[0], hypothesis_token)},
+            {"reference",            list_to_label_dict(unique_speaker_label, py_reference, 0)},
+            {"token_match",          string_vector_to_list(artifact.token_match_result)},
+            {"align_indices",        list_to_label_dict(unique_speaker_label, nested_int_vector_to_list(artifact.align_indices), 0)},
+            {"ref_original_indices", list_to_label_dict(unique_speaker_label, nested_int_vector_to_list(artifact.ref_original_indices), 0)},
+            {"speaker_label",        string_vector_to_list(unique_speaker_label)},
+            {"aligned_hypothesis_label", hypothesis_label_list ? string_vector_to_list(artifact.aligned_hypo_speaker_label) : Py_None}
+    };
+    bool is_failed = false;
+    for (auto& [key, value]: item) {
+        is_failed = is_failed || !value || PyDict_SetItemString(py_output, key, value) < 0;
+        Py_XDECREF(value);
+    }
+    if (is_failed) {
+        Py_DECREF(py_output);
+        return NULL;
+    }
+    return py_output;
+}
+
+static PyObject *align_token_id(PyObject *self, PyObject *args, PyObject *kwargs) {
+    PyObject *py_hypothesis;
+    PyObject *py_reference;
+    PyObject *py_reference_label;
+    PyObject *py_partial_match = NULL;
+    int segment_length = 0;
+    int barrier_length = 0;
+    msa_config config;
+    const char *engine = nullptr;
+    int store_traceback = 0;
+    Py_ssize_t max_memory_bytes = 0;
+    PyObject *py_stats = NULL;
+    alignment_stats stats;
+    const char *output = "token";
+    static const char *kwlist[] = {"hypothesis", "reference", "reference_label", "partial_match", "segment_length", "barrier_length", "thread_num", "band_width", "engine", "store_traceback", "max_memory_bytes", "output", "stats", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO|OiiiispnsO", (char **)kwlist, &py_hypothesis, &py_reference, &py_reference_label, &py_partial_match,
+                                     &segment_length, &barrier_length, &config.thread_num, &config.band_width, &engine, &store_traceback, &max_memory_bytes, &output, &py_stats)) {
+        return NULL;
+    }
+    bool is_index_output = std::string_view(output) == "index";
+    if (!is_index_output && std::string_view(output) != "token") {
+        PyErr_Format(PyExc_ValueError, "unknown output: %s", output);
+        return NULL;
+    }
+    if (!set_msa_config(engine, store_traceback, max_memory_bytes, config)) {
+        return NULL;
+    }
+    if (!set_alignment_stats(py_stats, stats, config)) {
+        return NULL;
+    }
+    int32_buffer hypothesis, reference, reference_label;
+    if (!get_int32_buffer(py_hypothesis, "hypothesis", hypothesis) || !get_int32_buffer(py_reference, "reference", reference)
+        || !get_int32_buffer(py_reference_label, "reference_label", reference_label)) {
+        return NULL;
+    }
+    python_partial_match callback;
+    std::unordered_set<uint64_t> pair_set;
+    partial_match_function is_partial_match;
+    if (!get_partial_match_function(py_partial_match, callback, pair_set, is_partial_match)) {
+        return NULL;
+    }
+
+    token_id_alignment result;
+    if (!run_without_gil([&]() { result = align_token_id(hypothesis.get(), reference.get(), reference_label.get(), is_partial_match, segment_length, barrier_length, config); })) {
+        callback.restore_error();
+        return NULL;
+    }
+    if (!update_stats_dict(py_stats, stats)) {
+        return NULL;
+    }
+
+    PyObject *py_speaker_id = PyList_New(result.speaker_id.size());
+    if (!py_speaker_id) {
+        return NULL;
+    }
+    for (int i = 0; i < result.speaker_id.size(); ++i) {
+        PyList_SET_ITEM(py_speaker_id, i, PyLong_FromUnsignedLong(result.speaker_id[i]));
+    }
+    if (is_index_output) {
+        PyObject *py_align_index = index_vector_to_bytes_list(result.align_index);
+        if (!py_align_index) {
+            Py_DECREF(py_speaker_id);
+            return NULL;
+        }
+        return Py_BuildValue("{s:N,s:N}", "speaker_id", py_speaker_id, "align_index", py_align_index);
+    }
+
+    // aligned token ids, -1 represents a gap
+    std::vector<std::vector<int>> align_id(result.align_index.size());
+    for (int i = 0; i < result.align_index.size(); ++i) {
+        std::span<const uint32_t> sequence = i == 0 ? hypothesis.get() : reference.get();
+        align_id[i].reserve(result.align_index[i].size());
+        for (int position: result.align_index[i]) {
+            align_id[i].emplace_back(position != -1 ? (int)sequence[position] : -1);
+        }
+    }
+    PyObject *py_align_id = nested_int_vector_to_list(align_id);
+    if (!py_align_id) {
+        Py_DECREF(py_speaker_id);
+        return NULL;
+    }
+    return Py_BuildValue("{s:N,s:N}", "speaker_id", py_speaker_id, "align_result", py_align_id);
+}
+
+static PyObject *estimate_alignment_cost(PyObject *self, PyObject *args, PyObject *kwargs) {
+    PyObject *hypothesis_list;
+    PyObject *reference_list;
+    PyObject *reference_label_list;
+    int segment_length = 0;
+    int barrier_length = 0;
+    msa_config config;
+    const char *engine = nullptr;
+    int store_traceback = 0;
+    Py_ssize_t max_memory_bytes = 0;
+    static const char *kwlist[] = {"hypothesis", "reference", "reference_label", "segment_length", "barrier_length", "thread_num", "band_width", "engine", "store_traceback", "max_memory_bytes", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O!O!|iiiispn", (char **)kwlist, &PyList_Type, &hypothesis_list, &PyList_Type, &reference_list, &PyList_Type, &reference_label_list, &segment_length, &barrier_length, &config.thread_num, &config.band_width, &engine, &store_traceback, &max_memory_bytes)) {
+        return NULL;
+    }
+    if (!set_msa_config(engine, store_traceback, max_memory_bytes, config)) {
+        return NULL;
+    }
+
+    std::vector<std::string> hypothesis, reference, reference_label;
+    if (!string_list_to_vector(hypothesis_list, hypothesis) || !string_list_to_vector(reference_list, reference)
+        || !string_list_to_vector(reference_label_list, reference_label)) {
+        return NULL;
+    }
+
+    std::vector<segment_cost> cost_list;
+    if (!run_without_gil([&]() { cost_list = estimate_alignment_cost(hypothesis, reference, reference_label, segment_length, barrier_length, config); })) {
+        return NULL;
+    }
+    PyObject *py_cost_list = PyList_New(cost_list.size());
+    if (!py_cost_list) {
+        return NULL;
+    }
+    for (int i = 0; i < cost_list.size(); ++i) {
+        const segment_cost& cost = cost_list[i];
+        PyObject *py_cost = Py_BuildValue("{s:i,s:i,s:i,s:i,s:s,s:i,s:K,s:K,s:d,s:O}",
+                                          "hypothesis_start", cost.hypothesis_start, "hypothesis_end", cost.hypothesis_end,
+                                          "reference_start", cost.reference_start, "reference_end", cost.reference_end,
+                                          "engine", get_engine_name(cost.cost.engine),
+                                          "band_width", cost.cost.band_width,
+                                          "cells", (unsigned long long)cost.cost.cell, "bytes", (unsigned long long)cost.cost.byte,
+                                          "seconds", cost.cost.second, "within_budget", cost.within_budget ? Py_True : Py_False);
+        if (!py_cost) {
+            Py_DECREF(py_cost_list);
+            return NULL;
+        }
+        PyList_SET_ITEM(py_cost_list, i, py_cost);
+    }
+    return py_cost_list;
+}
+
 static PyObject *get_token_match_result(PyObject *self, PyObject *args) {
     PyObject *py_align_result;
     int partial_bound = 2;
@@ -186,8 +1015,14 @@ static PyObject *get_token_match_result(PyObject *self, PyObject *args) {
         return NULL;
     }
 
-    std::vector<std::vector<std::string>> align_result = nested_str_list_to_vector(py_align_result);
-    std::vector<std::string> token_match_result = get_token_match_result(align_result, partial_bound);
+    std::vector<std::vector<std::string>> align_result;
+    if (!nested_str_list_to_vector(py_align_result, align_result)) {
+        return NULL;
+    }
+    std::vector<std::string> token_match_result;
+    if (!run_without_gil([&]() { token_match_result = get_token_match_result(align_result, partial_bound); })) {
+        return NULL;
+    }
     PyObject *py_token_match_result = string_vector_to_list(token_match_result);
     return Py_BuildValue("O", py_token_match_result);
 }
@@ -199,8 +1034,14 @@ static PyObject *get_align_indices(PyObject *self, PyObject *args) {
         return NULL;
     }
 
-    std::vector<std::vector<std::string>> align_result = nested_str_list_to_vector(py_align_result);
-    std::vector<std::vector<int>> align_indices = get_align_indices(align_result);
+    std::vector<std::vector<std::string>> align_result;
+    if (!nested_str_list_to_vector(py_align_result, align_result)) {
+        return NULL;
+    }
+    std::vector<std::vector<int>> align_indices;
+    if (!run_without_gil([&]() { align_indices = get_align_indices(align_result); })) {
+        return NULL;
+    }
     PyObject *py_align_indices = nested_int_vector_to_list(align_indices);
     return Py_BuildValue("O", py_align_indices);
 }
@@ -213,9 +1054,18 @@ static PyObject *get_ref_original_indices(PyObject *self, PyObject *args) {
         return NULL;
     }
 
-    std::vector<std::string> reference = string_list_to_vector(py_reference_list);
-    std::vector<std::string> speaker_label = string_list_to_vector(py_speaker_label_list);
-    std::vector<std::vector<int>> ref_original_indices = get_ref_original_indices(reference, speaker_label);
+    std::vector<std::string> reference;
+    if (!string_list_to_vector(py_reference_list, reference)) {
+        return NULL;
+    }
+    std::vector<std::string> speaker_label;
+    if (!string_list_to_vector(py_speaker_label_list, speaker_label)) {
+        return NULL;
+    }
+    std::vector<std::vector<int>> ref_original_indices;
+    if (!run_without_gil([&]() { ref_original_indices = get_ref_original_indices(reference, speaker_label); })) {
+        return NULL;
+    }
     PyObject *py_ref_original_indices_list = nested_int_vector_to_list(ref_original_indices);
     return Py_BuildValue("O", py_ref_original_indices_list);
 }
@@ -225,7 +1075,10 @@ static PyObject *get_unique_speaker_label(PyObject *self, PyObject *args) {
     if (!PyArg_ParseTuple(args, "O!", &PyList_Type, &py_speaker_label_list)) {
         return NULL;
     }
-    std::vector<std::string> speaker_label = string_list_to_vector(py_speaker_label_list);
+    std::vector<std::string> speaker_label;
+    if (!string_list_to_vector(py_speaker_label_list, speaker_label)) {
+        return NULL;
+    }
     std::vector<std::string> unique_speaker_label = get_unique_speaker_label(speaker_label);
     PyObject *py_unique_speaker_label_list = string_vector_to_list(unique_speaker_label);
     return Py_BuildValue("O", py_unique_speaker_label_list);
@@ -237,17 +1090,160 @@ static PyObject *get_aligned_hypo_speaker_label(PyObject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "O!O!", &PyList_Type, &py_align_result, &PyList_Type, &py_hypo_speaker_label_list)) {
         return NULL;
     }
-    std::vector<std::vector<std::string>> align_result = nested_str_list_to_vector(py_align_result);
-    std::vector<std::string> hypo_speaker_label = string_list_to_vector(py_hypo_speaker_label_list);
-    std::vector<std::string> aligned_hypo_speaker_label = get_aligned_hypo_speaker_label(align_result, hypo_speaker_label);
+    std::vector<std::vector<std::string>> align_result;
+    if (!nested_str_list_to_vector(py_align_result, align_result)) {
+        return NULL;
+    }
+    std::vector<std::string> hypo_speaker_label;
+    if (!string_list_to_vector(py_hypo_speaker_label_list, hypo_speaker_label)) {
+        return NULL;
+    }
+    std::vector<std::string> aligned_hypo_speaker_label;
+    if (!run_without_gil([&]() { aligned_hypo_speaker_label = get_aligned_hypo_speaker_label(align_result, hypo_speaker_label); })) {
+        return NULL;
+    }
     PyObject *py_aligned_hypo_speaker_label_list = string_vector_to_list(aligned_hypo_speaker_label);
     return Py_BuildValue("O", py_aligned_hypo_speaker_label_list);
 }
 
+typedef struct {
+    PyObject_HEAD
+    stream_aligner *aligner;
+    std::mutex *lock;  // the GIL is released while aligning, so calls on the same aligner from several threads are serialized here
+} StreamAlignerObject;
+
+static int StreamAligner_init(StreamAlignerObject *self, PyObject *args, PyObject *kwargs) {
+    int segment_length = AUTO_SEGMENT_MIN_LENGTH;
+    int barrier_length = AUTO_SEGMENT_BARRIER_LENGTH;
+    int partial_bound = 2;
+    msa_config config;
+    const char *engine = nullptr;
+    int store_traceback = 0;
+    Py_ssize_t max_memory_bytes = 0;
+    static const char *kwlist[] = {"segment_length", "barrier_length", "partial_bound", "thread_num", "band_width", "engine", "store_traceback", "max_memory_bytes", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|iiiiispn", (char **)kwlist, &segment_length, &barrier_length, &partial_bound, &config.thread_num, &config.band_width, &engine, &store_traceback, &max_memory_bytes)) {
+        return -1;
+    }
+    if (!set_msa_config(engine, store_traceback, max_memory_bytes, config)) {
+        return -1;
+    }
+    try {
+        if (!self->lock) {
+            self->lock = new std::mutex();
+        }
+        std::lock_guard<std::mutex> guard(*self->lock);
+        delete self->aligner;
+        self->aligner = nullptr;
+        self->aligner = new stream_aligner(segment_length, barrier_length, partial_bound, config);
+    } catch (...) {
+        set_python_error(std::current_exception());
+        return -1;
+    }
+    return 0;
+}
+
+static void StreamAligner_dealloc(StreamAlignerObject *self) {
+    delete self->aligner;
+    delete self->lock;
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *stream_result_to_dict(const stream_result& result) {
+    /*
+     * Parse c++ stream result to python dictionary
+     */
+    PyObject *py_speaker_label = string_vector_to_list(result.speaker_label);
+    if (!py_speaker_label) {
+        return NULL;
+    }
+    PyObject *py_align_result = nested_str_vector_to_list(result.align_result);
+    if (!py_align_result) {
+        Py_DECREF(py_speaker_label);
+        return NULL;
+    }
+    return Py_BuildValue("{s:i,s:i,s:N,s:N}", "hypothesis_start", result.hypothesis_start, "reference_start", result.reference_start,
+                         "speaker_label", py_speaker_label, "align_result", py_align_result);
+}
+
+static PyObject *StreamAligner_append(StreamAlignerObject *self, PyObject *args, PyObject *kwargs) {
+    PyObject *hypothesis_list;
+    PyObject *reference_list = NULL;
+    PyObject *reference_label_list = NULL;
+    static const char *kwlist[] = {"hypothesis", "reference", "reference_label", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!|O!O!", (char **)kwlist, &PyList_Type, &hypothesis_list, &PyList_Type, &reference_list, &PyList_Type, &reference_label_list)) {
+        return NULL;
+    }
+    if (!self->aligner) {
+        PyErr_SetString(PyExc_RuntimeError, "StreamAligner is not initialized");
+        return NULL;
+    }
+
+    std::vector<std::string> hypothesis, reference, reference_label;
+    if (!string_list_to_vector(hypothesis_list, hypothesis) || (reference_list && !string_list_to_vector(reference_list, reference))
+        || (reference_label_list && !string_list_to_vector(reference_label_list, reference_label))) {
+        return NULL;
+    }
+    if (!run_without_gil([&]() {
+        std::lock_guard<std::mutex> guard(*self->lock);
+        self->aligner->append(hypothesis, reference, reference_label);
+    })) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *StreamAligner_emit(StreamAlignerObject *self, PyObject *Py_UNUSED(args)) {
+    if (!self->aligner) {
+        PyErr_SetString(PyExc_RuntimeError, "StreamAligner is not initialized");
+        return NULL;
+    }
+    stream_result result;
+    if (!run_without_gil([&]() {
+        std::lock_guard<std::mutex> guard(*self->lock);
+        result = self->aligner->emit();
+    })) {
+        return NULL;
+    }
+    return stream_result_to_dict(result);
+}
+
+static PyObject *StreamAligner_flush(StreamAlignerObject *self, PyObject *Py_UNUSED(args)) {
+    if (!self->aligner) {
+        PyErr_SetString(PyExc_RuntimeError, "StreamAligner is not initialized");
+        return NULL;
+    }
+    stream_result result;
+    if (!run_without_gil([&]() {
+        std::lock_guard<std::mutex> guard(*self->lock);
+        result = self->aligner->flush();
+    })) {
+        return NULL;
+    }
+    return stream_result_to_dict(result);
+}
+
+static PyMethodDef StreamAligner_methods[] = {
+        {"append", (PyCFunction)(void (*)(void))(PyCFunctionWithKeywords)StreamAligner_append, METH_VARARGS | METH_KEYWORDS, "append hypothesis tokens and optionally reference tokens with speaker labels."},
+        {"emit",   (PyCFunction)StreamAligner_emit,   METH_NOARGS, "align and remove the tokens before the last confirmed barrier."},
+        {"flush",  (PyCFunction)StreamAligner_flush,  METH_NOARGS, "align and remove all remaining tokens."},
+        {NULL, NULL, 0, NULL}
+};
+
+static PyTypeObject StreamAlignerType = {
+        PyVarObject_HEAD_INIT(NULL, 0)
+};
+
 static PyMethodDef align4d_funcs[] = {
-        {"align_without_segment",     align_without_segment,     METH_VARARGS, "multi-sequence alignment without segmentation."},
-        {"align_with_auto_segment",   align_with_auto_segment,   METH_VARARGS, "multi-sequence alignment with automatic segmentation."},
-        {"align_with_manual_segment", align_with_manual_segment, METH_VARARGS, "multi-sequence alignment with manual segmentation."},
+        {"align_without_segment",     (PyCFunction)(void (*)(void))(PyCFunctionWithKeywords)align_without_segment,     METH_VARARGS | METH_KEYWORDS, "multi-sequence alignment without segmentation."},
+        {"align_with_auto_segment",   (PyCFunction)(void (*)(void))(PyCFunctionWithKeywords)align_with_auto_segment,   METH_VARARGS | METH_KEYWORDS, "multi-sequence alignment with automatic segmentation."},
+        {"align_with_manual_segment", (PyCFunction)(void (*)(void))(PyCFunctionWithKeywords)align_with_manual_segment, METH_VARARGS | METH_KEYWORDS, "multi-sequence alignment with manual segmentation."},
+        {"align_batch",               (PyCFunction)(void (*)(void))(PyCFunctionWithKeywords)align_batch,               METH_VARARGS | METH_KEYWORDS, "multi-sequence alignment of many jobs in parallel."},
+        {"align_index",               (PyCFunction)(void (*)(void))(PyCFunctionWithKeywords)align_index,               METH_VARARGS | METH_KEYWORDS, "multi-sequence alignment giving int32 index of the aligned tokens in the original sequences."},
+        {"align_artifact",            (PyCFunction)(void (*)(void))(PyCFunctionWithKeywords)align_artifact,            METH_VARARGS | METH_KEYWORDS, "multi-sequence alignment with all post-processing results in a single pass."},
+        {"align_token_id",            (PyCFunction)(void (*)(void))(PyCFunctionWithKeywords)align_token_id,            METH_VARARGS | METH_KEYWORDS, "multi-sequence alignment of int32 token ids read through the buffer protocol."},
+        {"estimate_alignment_cost",   (PyCFunction)(void (*)(void))(PyCFunctionWithKeywords)estimate_alignment_cost,   METH_VARARGS | METH_KEYWORDS, "estimate cells, memory and time of each segment of an alignment."},
         {"get_token_match_result",    get_token_match_result,    METH_VARARGS, "get token match result from alignment result."},
         {"get_align_indices",         get_align_indices,         METH_VARARGS, "get indices map from separated references to hypothesis."},
         {"get_ref_original_indices",  get_ref_original_indices,  METH_VARARGS, "get indices map from separated references to original combined reference."},
@@ -266,5 +1262,31 @@ static PyModuleDef align4d = {
 
 PyMODINIT_FUNC
 PyInit_align4d(void) {
-    return PyModule_Create(&align4d);
+    StreamAlignerType.tp_name = "align4d.StreamAligner";
+    StreamAlignerType.tp_basicsize = sizeof(StreamAlignerObject);
+    StreamAlignerType.tp_dealloc = (destructor)StreamAligner_dealloc;
+    StreamAlignerType.tp_flags = Py_TPFLAGS_DEFAULT;
+    StreamAlignerType.tp_doc = "streaming multi-sequence alignment that keeps only the tokens after the last confirmed barrier.";
+    StreamAlignerType.tp_methods = StreamAligner_methods;
+    StreamAlignerType.tp_init = (initproc)StreamAligner_init;
+    StreamAlignerType.tp_new = PyType_GenericNew;
+    if (PyType_Ready(&StreamAlignerType) < 0) {
+        return NULL;
+    }
+    PyObject *module = PyModule_Create(&align4d);
+    if (!module) {
+        return NULL;
+    }
+#ifdef Py_GIL_DISABLED
+    // no global state is shared between calls, and the lists of the caller are only read while locked or held by a strong reference,
+    // so the module can run on free-threaded python without the GIL
+    PyUnstable_Module_SetGIL(module, Py_MOD_GIL_NOT_USED);
+#endif
+    Py_INCREF(&StreamAlignerType);
+    if (PyModule_AddObject(module, "StreamAligner", (PyObject *)&StreamAlignerType) < 0) {
+        Py_DECREF(&StreamAlignerType);
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
 }
\ No newline at end of file
@@ -1,12 +1,23 @@
 #include <algorithm>
+#include <atomic>
+#include <barrier>
 #include <chrono>
+#include <climits>
+#include <cmath>
 #include <iostream>
 #include <numeric>
+#include <queue>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "msa.h"
 
-int edit_distance(const std::string &token1, const std::string &token2) {
+int edit_distance(std::string_view token1, std::string_view token2) {
     /*
      * Calculate the edit distance using Levenshtein Distance by dynamic programming
      *
@@ -36,6 +47,148 @@ int edit_distance(const std::string &token1, const std::string &token2) {
     return matrix[token1.length()][token2.length()];
 }
 
+bool bit_parallel_edit_distance_below(std::string_view pattern, std::string_view text, int bound) {
+    /*
+     * Check if the edit distance is smaller than bound using Myers/Hyyro bit-vector algorithm,
+     * each column of the Levenshtein Distance matrix is encoded as vertical deltas in a 64-bit word.
+     * The check stops as soon as the distance can no longer fall below bound even if every remaining character matches.
+     *
+     * @param pattern: the shorter token with at most 64 characters
+     * @param text: the longer token
+     * @param bound: upper bound (exclusive) of the edit distance
+     * @return: true if the edit distance between pattern and text is smaller than bound
+     */
+    if (pattern.empty()) {
+        return text.length() < bound;
+    }
+    // only the entries of characters in the two tokens are initialized and read
+    uint64_t peq[256];
+    for (char c: text) {
+        peq[(unsigned char)c] = 0;
+    }
+    for (char c: pattern) {
+        peq[(unsigned char)c] = 0;
+    }
+    for (int i = 0; i < pattern.length(); ++i) {
+        peq[(unsigned char)pattern[i]] |= (uint64_t)1 << i;
+    }
+    const uint64_t last = (uint64_t)1 << (pattern.length() - 1);
+    uint64_t pv = ~(uint64_t)0, mv = 0;
+    int distance = (int)pattern.length();
+    for (int j = 0; j < text.length(); ++j) {
+        uint64_t eq = peq[(unsigned char)text[j]];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & last) {
+            distance++;
+        } else if (mh & last) {
+            distance--;
+        }
+        if (distance - (int)(text.length() - j - 1) >= bound) {
+            return false;
+        }
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+    return distance < bound;
+}
+
+bool banded_edit_distance_below(std::string_view token1, std::string_view token2, int bound) {
+    /*
+     * Check if the edit distance is smaller than bound using Ukkonen's banded dynamic programming,
+     * only the cells within bound - 1 of the main diagonal are calculated with two rows kept on the stack.
+     * The check stops as soon as every cell in the current row reaches bound.
+     * Falls back to the full edit_distance if the band does not fit on the stack.
+     *
+     * @param token1: the first token
+     * @param token2: the second token
+     * @param bound: upper bound (exclusive) of the edit distance
+     * @return: true if the edit distance between token1 and token2 is smaller than bound
+     */
+    if (bound <= 0 || std::abs((int)token1.length() - (int)token2.length()) >= bound) {
+        return false;
+    }
+    constexpr int max_band = 2 * EDIT_DISTANCE_MAX_BAND_RADIUS + 1;
+    const int radius = bound - 1;
+    const int band = 2 * radius + 1;
+    if (band > max_band) {
+        return edit_distance(token1, token2) < bound;
+    }
+    // cell (i, j) is stored at j - i + radius, cells outside of the band are treated as bound
+    int previous[max_band + 2], current[max_band + 2];
+    std::fill(previous, previous + band + 2, bound);
+    std::fill(current, current + band + 2, bound);
+    for (int j = 0; j <= std::min<int>(radius, (int)token2.length()); ++j) {
+        previous[j + radius + 1] = j;
+    }
+    for (int i = 1; i <= token1.length(); ++i) {
+        int row_min{bound};
+        current[0] = bound;
+        for (int d = 0; d < band; ++d) {
+            int j = i + d - radius;
+            if (j < 0 || j > token2.length()) {
+                current[d + 1] = bound;
+                continue;
+            }
+            int cell;
+            if (j == 0) {
+                cell = i;
+            } else {
+                int substitution = token1[i - 1] == token2[j - 1] ? 0 : 1;
+                cell = std::min({previous[d + 1] + substitution, previous[d + 2] + 1, current[d] + 1});
+            }
+            current[d + 1] = std::min(cell, bound);
+            row_min = std::min(row_min, current[d + 1]);
+        }
+        if (row_min >= bound) {
+            return false;
+        }
+        std::swap(previous, current);
+    }
+    return previous[(int)token2.length() - (int)token1.length() + radius + 1] < bound;
+}
+
+bool edit_distance_below(std::string_view token1, std::string_view token2, int bound) {
+    /*
+     * Check if the edit distance between two tokens is smaller than bound without allocation,
+     * this is the only information needed to tell partially matched tokens from mis-matched tokens.
+     *
+     * Tokens with at most 64 characters use a bit-parallel algorithm, the others use a banded dynamic programming,
+     * both of them stop early once the distance is known to reach bound.
+     *
+     * @param token1: the first token
+     * @param token2: the second token
+     * @param bound: upper bound (exclusive) of the edit distance
+     * @return: true if the edit distance between token1 and token2 is smaller than bound
+     */
+    if (bound <= 0) {
+        return false;
+    }
+    if (token1 == token2) {
+        return true;
+    }
+    if (token1.length() > token2.length()) {
+        std::swap(token1, token2);
+    }
+    if (token2.length() - token1.length() >= bound) { // the distance is at least the difference of length
+        return false;
+    }
+    if (token2.length() < bound) { // the distance is at most the length of the longer token
+        return true;
+    }
+    if (token1.empty()) {
+        return token2.length() < bound;
+    }
+    if (token1.length() <= 64) {
+        return bit_parallel_edit_distance_below(token1, token2, bound);
+    }
+    return banded_edit_distance_below(token1, token2, bound);
+}
+
 int compare(const std::string &hypothesis, const std::vector<std::string> &reference_list, int partial_bound) {
     /*
      * Give score for comparison between hypothesis token and reference tokens
@@ -67,7 +220,7 @@ int compare(const std::string &hypothesis, const std::vector<std::string> &refer
     } else {
         if (hypothesis == reference) { // fully matched situation
             return FULLY_MATCH_SCORE;
-        } else if (edit_distance(hypothesis, reference) < partial_bound) { // partially matched situation
+        } else if (edit_distance_below(hypothesis, reference, partial_bound)) { // partially matched situation
             return PARTIAL_MATCH_SCORE;
         } else { // mis-matched
             return MISMATCH_SCORE;
@@ -236,104 +389,1544 @@ size_t get_index(const std::vector<int>& current_index, const std::vector<int>&
     return index;
 }
 
-std::vector<std::vector<std::string>> multi_sequence_alignment(const std::vector<std::string>& hypothesis, const std::vector<std::vector<std::string>>& reference, int partial_bound) {
+token_interner::token_interner(std::vector<std::string_view>& vocabulary) : vocabulary(vocabulary), token_id{{GAP, GAP_ID}} {
+    vocabulary.assign(1, GAP);
+}
+
+std::vector<uint32_t> token_interner::intern(const std::vector<std::string>& sequence) {
     /*
-     * The actual function to do the multi-sequence alignment based on Needleman-Wunsch algorithm, a dynamic programming approach
-     * This algorithm expands the original Needleman-Wunsch algorithm to multidimensional way
-     * For the scoring matrix for dynamic programming, because it is hard to allocate for multidimensional array or vectors
-     * this implementation uses one dimensional vector of 2byte int with an index conversion function to mimic the multidimensional array
+     * Get the id of each token of the sequence, a token seen for the first time gets the next id and is added to the vocabulary
+     */
+    std::vector<uint32_t> id_sequence;
+    id_sequence.reserve(sequence.size());
+    for (const std::string& token: sequence) {
+        auto [it, inserted] = token_id.try_emplace(token, (uint32_t)vocabulary.size());
+        if (inserted) {
+            vocabulary.emplace_back(token);
+        }
+        id_sequence.emplace_back(it->second);
+    }
+    return id_sequence;
+}
+
+std::vector<std::vector<uint32_t>> intern_token(const std::vector<std::string>& hypothesis, const std::vector<std::vector<std::string>>& reference, std::vector<std::string_view>& vocabulary) {
+    /*
+     * Map every token of the hypothesis and separated references to an integer id so that the dynamic programming
+     * can compare tokens without copying or comparing strings.
+     *
+     * The vocabulary is built once per alignment, equal tokens share the same id, and GAP is always GAP_ID,
+     * a token equal to GAP is therefore treated as a gap in the same way as the compare function does.
      *
      * @param hypothesis: sequence of tokens for hypothesis as vector of strings
      * @param reference: sequences of tokens for separated references (by speaker) as 2d vector of strings
-     * @return: aligned hypothesis and separated references as 2d vector of strings
+     * @param vocabulary: output vector mapping each id back to its token, the views refer to the input sequences
+     * @return: 2d vector of token ids, the first one is the hypothesis and the rest are the separated references
      */
-    std::vector<std::vector<std::string>> speaker_sequence;
-    speaker_sequence.emplace_back(hypothesis);
+    token_interner interner(vocabulary);
+    std::vector<std::vector<uint32_t>> token_id_sequence;
+    token_id_sequence.emplace_back(interner.intern(hypothesis));
     for (const std::vector<std::string>& ref: reference) {
-        speaker_sequence.emplace_back(ref);
+        token_id_sequence.emplace_back(interner.intern(ref));
+    }
+    return token_id_sequence;
+}
+
+int compare(uint32_t hypothesis, uint32_t reference, const std::vector<std::string_view>& vocabulary, int partial_bound) {
+    /*
+     * Give score for comparison between hypothesis token and reference token represented by their ids,
+     * the result is exactly the same as the compare function on strings with at most 1 non-gap reference token.
+     *
+     * @param hypothesis: id of the hypothesis token, can be GAP_ID
+     * @param reference: id of the only non-gap reference token, GAP_ID if all reference tokens are gaps
+     * @param vocabulary: mapping from token id to token produced by intern_token
+     * @return: different score as an integer.
+     */
+    if (reference == GAP_ID) {
+        return GAP_SCORE;
+    } else if (hypothesis == reference) {
+        return FULLY_MATCH_SCORE;
+    } else if (edit_distance_below(vocabulary[hypothesis], vocabulary[reference], partial_bound)) {
+        return PARTIAL_MATCH_SCORE;
+    } else {
+        return MISMATCH_SCORE;
+    }
+}
+
+score_table get_score_table(const std::vector<std::vector<uint32_t>>& token_id_sequence, const std::vector<std::string_view>& vocabulary, int partial_bound) {
+    /*
+     * Precompute the comparison score between every hypothesis position and every reference position,
+     * so that the dynamic programming and backtracking only look up scores instead of calculating edit distance.
+     *
+     * Besides the hypothesis tokens, the table also includes the score of each reference token compared with a GAP as hypothesis,
+     * which is used when only a reference token is consumed. Each distinct pair of tokens is only compared once.
+     *
+     * @param token_id_sequence: token ids of hypothesis and separated references from intern_token
+     * @param vocabulary: mapping from token id to token produced by intern_token
+     * @return: score table of all hypothesis and reference positions
+     */
+    const std::vector<uint32_t>& hypothesis = token_id_sequence[0];
+    score_table table;
+    table.row_size = hypothesis.size() + 1;
+    std::unordered_map<uint64_t, int8_t> pair_score;
+    for (int i = 1; i < token_id_sequence.size(); ++i) {
+        const std::vector<uint32_t>& reference = token_id_sequence[i];
+        std::vector<int8_t> speaker_score(reference.size() * table.row_size);
+        for (int j = 0; j < reference.size(); ++j) {
+            for (int k = 0; k < table.row_size; ++k) {
+                uint32_t hypothesis_token = k == 0 ? GAP_ID : hypothesis[k - 1];
+                auto [it, inserted] = pair_score.try_emplace(((uint64_t)hypothesis_token << 32) | reference[j]);
+                if (inserted) {
+                    it->second = (int8_t)compare(hypothesis_token, reference[j], vocabulary, partial_bound);
+                    ++table.compare_call;
+                    table.edit_distance_call += reference[j] != GAP_ID && hypothesis_token != reference[j];
+                }
+                speaker_score[j * table.row_size + k] = it->second;
+            }
+        }
+        table.score.emplace_back(std::move(speaker_score));
+    }
+    return table;
+}
+
+int compare(uint32_t hypothesis, uint32_t reference, const partial_match_function& is_partial_match) {
+    /*
+     * Give score for comparison between hypothesis token id and reference token id given by the caller (integer token input),
+     * ids are not interned from strings, so the partial match is decided by is_partial_match instead of edit distance.
+     *
+     * @param is_partial_match: decide if two different token ids are partially matched, empty for no partial match
+     * @return: different score as an integer.
+     */
+    if (hypothesis == reference) {
+        return FULLY_MATCH_SCORE;
+    } else if (is_partial_match && is_partial_match(hypothesis, reference)) {
+        return PARTIAL_MATCH_SCORE;
+    } else {
+        return MISMATCH_SCORE;
     }
+}
+
+score_table get_score_table(const std::vector<std::vector<uint32_t>>& token_id_sequence, const partial_match_function& is_partial_match) {
+    /*
+     * Precompute the comparison score of integer token input, same as the score table of interned tokens above.
+     *
+     * There is no GAP token among the integer ids, so a reference token consumed alone always scores GAP_SCORE.
+     * Each distinct pair of ids is only compared once, which also bounds the number of calls to is_partial_match.
+     *
+     * @param token_id_sequence: token ids of hypothesis and separated references given by the caller
+     * @param is_partial_match: decide if two different token ids are partially matched, empty for no partial match
+     * @return: score table of all hypothesis and reference positions
+     */
+    const std::vector<uint32_t>& hypothesis = token_id_sequence[0];
+    score_table table;
+    table.row_size = hypothesis.size() + 1;
+    std::unordered_map<uint64_t, int8_t> pair_score;
+    for (int i = 1; i < token_id_sequence.size(); ++i) {
+        const std::vector<uint32_t>& reference = token_id_sequence[i];
+        std::vector<int8_t> speaker_score(reference.size() * table.row_size);
+        for (int j = 0; j < reference.size(); ++j) {
+            speaker_score[j * table.row_size] = GAP_SCORE;
+            for (int k = 1; k < table.row_size; ++k) {
+                auto [it, inserted] = pair_score.try_emplace(((uint64_t)hypothesis[k - 1] << 32) | reference[j]);
+                if (inserted) {
+                    it->second = (int8_t)compare(hypothesis[k - 1], reference[j], is_partial_match);
+                    ++table.compare_call;
+                }
+                speaker_score[j * table.row_size + k] = it->second;
+            }
+        }
+        table.score.emplace_back(std::move(speaker_score));
+    }
+    return table;
+}
+
+stage_timer::stage_timer(alignment_stats *stats, long long alignment_stats::*stage) : stats(stats), stage(stage) {
+    if (stats) {
+        start = std::chrono::steady_clock::now();
+    }
+}
+
+stage_timer::~stage_timer() {
+    stop();
+}
+
+long long stage_timer::stop() {
+    /*
+     * Add the time since construction to the stage and stop measuring, later calls add nothing
+     *
+     * @return: the added time in nanoseconds, 0 without stats
+     */
+    if (!stats) {
+        return 0;
+    }
+    long long nanosecond = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    stats->*stage += nanosecond;
+    stats = nullptr;
+    return nanosecond;
+}
+
+void add_alignment_stats(alignment_stats& stats, const alignment_stats& other) {
+    /*
+     * Add the times and counters of another alignment (a segment or a job) to the stats, the peak tensor size is the larger one
+     */
+    stats.segmentation_nanosecond += other.segmentation_nanosecond;
+    stats.parameter_search_nanosecond += other.parameter_search_nanosecond;
+    stats.score_table_nanosecond += other.score_table_nanosecond;
+    stats.fill_nanosecond += other.fill_nanosecond;
+    stats.traceback_nanosecond += other.traceback_nanosecond;
+    stats.stitch_nanosecond += other.stitch_nanosecond;
+    stats.exact_check_nanosecond += other.exact_check_nanosecond;
+    stats.total_nanosecond += other.total_nanosecond;
+    stats.segment_num += other.segment_num;
+    stats.cell += other.cell;
+    stats.compare_call += other.compare_call;
+    stats.edit_distance_call += other.edit_distance_call;
+    stats.peak_tensor_byte = std::max(stats.peak_tensor_byte, other.peak_tensor_byte);
+    stats.exact_check_segment += other.exact_check_segment;
+    stats.score_gap += other.score_gap;
+    stats.band_limited_segment += other.band_limited_segment;
+    stats.band_width = std::max(stats.band_width, other.band_width);
+    stats.segment_nanosecond.insert(stats.segment_nanosecond.end(), other.segment_nanosecond.begin(), other.segment_nanosecond.end());
+}
+
+void add_score_table_stats(alignment_stats *stats, const score_table& table) {
+    if (stats) {
+        stats->compare_call += table.compare_call;
+        stats->edit_distance_call += table.edit_distance_call;
+    }
+}
+
+int get_thread_num(int thread_num) {
+    /*
+     * Get the actual number of threads to use, 0 or negative means using all hardware threads
+     */
+    if (thread_num > 0) {
+        return thread_num;
+    }
+    return std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+std::vector<size_t> get_stride(const std::vector<int>& matrix_size) {
+    /*
+     * Calculate the distance in the one dimensional scoring matrix between two cells that differ by 1 in each dimension,
+     * so that the one dimensional index of a multidimensional index is the sum of index times stride of each dimension
+     *
+     * @param matrix_size: shape of the scoring matrix in multidimensional way (the length of each sequence)
+     * @return: stride of each dimension as vector of integers
+     */
+    std::vector<size_t> stride(matrix_size.size(), 1);
+    for (int i = (int)matrix_size.size() - 2; i >= 0; --i) {
+        stride[i] = stride[i + 1] * matrix_size[i + 1];
+    }
+    return stride;
+}
+
+std::vector<std::vector<neighbour_move>> get_neighbour_move_list(const std::vector<size_t>& stride) {
+    /*
+     * Precompute the moves to the previous cells used for comparison for every combination of sequence positions,
+     * this is the stride based equivalent of get_parameter_index_list and keeps exactly the same order of the previous cells.
+     *
+     * @param stride: stride of each dimension from get_stride
+     * @return: 2d vector of moves, the moves for the sequence positions with bit i set for sequence i are at index of that bit mask
+     */
+    int sequence_num = (int)stride.size();
+    std::vector<std::vector<neighbour_move>> neighbour_move_list(1 << sequence_num);
+    for (int mask = 1; mask < (1 << sequence_num); ++mask) {
+        for (int i = 0; i < sequence_num; ++i) {
+            if (mask & (1 << i)) {
+                neighbour_move_list[mask].push_back({stride[i], i, false});
+                if ((mask & 1) && i != 0) {
+                    neighbour_move_list[mask].push_back({stride[i] + stride[0], i, true});
+                }
+            }
+        }
+    }
+    return neighbour_move_list;
+}
+
+void fill_score(std::vector<int16_t>& score, std::vector<uint8_t>& traceback, const std::vector<int>& matrix_size, const std::vector<size_t>& stride,
+                const std::vector<std::vector<neighbour_move>>& neighbour_move_list, const score_table& table) {
+    /*
+     * Fill the scoring matrix sequentially, the cells are grouped by the sequences they involve (sequence positions)
+     * and filled in the order that all previous cells used for comparison are filled before the current cell.
+     *
+     * @param score: one dimensional scoring matrix to be filled
+     * @param traceback: index of the winning move in neighbour_move_list of each cell to be filled, empty to skip
+     * @param matrix_size: shape of the scoring matrix in multidimensional way (the length of each sequence)
+     * @param stride: stride of each dimension from get_stride
+     * @param neighbour_move_list: moves to the previous cells from get_neighbour_move_list
+     * @param table: score table from get_score_table
+     */
+    std::vector<int> current_index(matrix_size.size());
+    for (const std::vector<int>& sequence_position: get_sequence_position_list((int)matrix_size.size())) {
+        int mask{0};
+        size_t index{0};
+        std::ranges::fill(current_index, 0);
+        for (int i: sequence_position) {
+            mask |= 1 << i;
+            index += stride[i];
+            current_index[i] = 1;
+        }
+        if (std::ranges::any_of(sequence_position, [&](int i) { return matrix_size[i] == 1; })) {
+            continue; // empty sequence
+        }
+        const std::vector<neighbour_move>& neighbour_move = neighbour_move_list[mask];
+        while (true) {
+            int max_score{INT_MIN};
+            int max_move{0};
+            for (int k = 0; k < neighbour_move.size(); ++k) {
+                int move_score = score[index - neighbour_move[k].offset] + get_move_score(neighbour_move[k], current_index, table);
+                if (move_score > max_score) {
+                    max_score = move_score;
+                    max_move = k;
+                }
+            }
+            score[index] = (int16_t)max_score;
+            if (!traceback.empty()) {
+                traceback[index] = (uint8_t)max_move;
+            }
+            int i = (int)sequence_position.size() - 1;
+            for (; i >= 0; --i) {
+                int dimension = sequence_position[i];
+                current_index[dimension]++;
+                index += stride[dimension];
+                if (current_index[dimension] < matrix_size[dimension]) {
+                    break;
+                }
+                index -= (matrix_size[dimension] - 1) * stride[dimension];
+                current_index[dimension] = 1;
+            }
+            if (i < 0) {
+                break;
+            }
+        }
+    }
+}
+
+void fill_score_wavefront(std::vector<int16_t>& score, std::vector<uint8_t>& traceback, const std::vector<int>& matrix_size, const std::vector<size_t>& stride,
+                          const std::vector<std::vector<neighbour_move>>& neighbour_move_list, const score_table& table, int thread_num) {
+    /*
+     * Fill the scoring matrix with multiple threads by sweeping the hyperplanes (cells with the same sum of indexes).
+     * Every previous cell used for comparison is on an earlier hyperplane, so the cells on the same hyperplane
+     * are independent of each other and are shared among threads, all threads wait for each other before the next hyperplane.
+     * The cells of each hyperplane are distributed by their hypothesis index.
+     *
+     * @param score: one dimensional scoring matrix to be filled
+     * @param traceback: index of the winning move in neighbour_move_list of each cell to be filled, empty to skip
+     * @param matrix_size: shape of the scoring matrix in multidimensional way (the length of each sequence)
+     * @param stride: stride of each dimension from get_stride
+     * @param neighbour_move_list: moves to the previous cells from get_neighbour_move_list
+     * @param table: score table from get_score_table
+     * @param thread_num: number of threads
+     */
+    int sequence_num = (int)matrix_size.size();
+    // maximum sum of indexes from each dimension to the last one
+    std::vector<int> remain_max(sequence_num + 1, 0);
+    for (int i = sequence_num - 1; i >= 0; --i) {
+        remain_max[i] = remain_max[i + 1] + matrix_size[i] - 1;
+    }
+    std::atomic<int> next_hypothesis_index{0};
+    std::barrier sync(thread_num, [&]() noexcept { next_hypothesis_index = 0; });
+
+    auto worker = [&]() {
+        std::vector<int> current_index(sequence_num);
+        auto fill_cell = [&](size_t index, int mask) {
+            const std::vector<neighbour_move>& neighbour_move = neighbour_move_list[mask];
+            int max_score{INT_MIN};
+            int max_move{0};
+            for (int k = 0; k < neighbour_move.size(); ++k) {
+                int move_score = score[index - neighbour_move[k].offset] + get_move_score(neighbour_move[k], current_index, table);
+                if (move_score > max_score) {
+                    max_score = move_score;
+                    max_move = k;
+                }
+            }
+            score[index] = (int16_t)max_score;
+            if (!traceback.empty()) {
+                traceback[index] = (uint8_t)max_move;
+            }
+        };
+        // enumerate every cell on the hyperplane with the remaining sum of indexes for dimensions from the current one
+        auto fill_remain = [&](auto& self, int dimension, int remain, size_t index, int mask) -> void {
+            if (dimension == sequence_num) {
+                fill_cell(index, mask);
+                return;
+            }
+            int lower = std::max(0, remain - remain_max[dimension + 1]);
+            int upper = std::min(matrix_size[dimension] - 1, remain);
+            for (int i = lower; i <= upper; ++i) {
+                current_index[dimension] = i;
+                self(self, dimension + 1, remain - i, index + i * stride[dimension], i != 0 ? mask | (1 << dimension) : mask);
+            }
+        };
+        for (int hyperplane = 1; hyperplane <= remain_max[0]; ++hyperplane) {
+            int lower = std::max(0, hyperplane - remain_max[1]);
+            int upper = std::min(matrix_size[0] - 1, hyperplane);
+            for (int i = lower + next_hypothesis_index++; i <= upper; i = lower + next_hypothesis_index++) {
+                current_index[0] = i;
+                fill_remain(fill_remain, 1, hyperplane - i, i * stride[0], i != 0 ? 1 : 0);
+            }
+            sync.arrive_and_wait();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < thread_num; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread: threads) {
+        thread.join();
+    }
+}
+
+std::vector<std::vector<int>> dense_alignment_index(const std::vector<std::vector<uint32_t>>& token_id_sequence, const score_table& table, const msa_config& config) {
+    /*
+     * The actual function to do the multi-sequence alignment based on Needleman-Wunsch algorithm, a dynamic programming approach
+     * This algorithm expands the original Needleman-Wunsch algorithm to multidimensional way
+     * For the scoring matrix for dynamic programming, because it is hard to allocate for multidimensional array or vectors
+     * this implementation uses one dimensional vector of 2byte int with precomputed strides to mimic the multidimensional array,
+     * each cell is visited with its one dimensional index and the precomputed offsets to the previous cells without any allocation
+     * With traceback stored, the winning move of each cell is kept in one more byte per cell during filling,
+     * so that backtracking follows the stored moves without comparing the scores of previous cells again
+     *
+     * @param token_id_sequence: token ids of hypothesis and separated references (by speaker) from intern_token
+     * @param table: score table from get_score_table
+     * @param config: options of the alignment engine
+     * @return: aligned position of each sequence as 2d vector of integers, each integer is the index of the token
+     * in its own sequence, -1 represents a gap
+     */
     std::vector<int> matrix_size;
     size_t total_cell{1};
-    for (const std::vector<std::string>& speaker: speaker_sequence) {
+    for (const std::vector<uint32_t>& speaker: token_id_sequence) {
         matrix_size.emplace_back(speaker.size() + 1);
         total_cell *= speaker.size() + 1;
     }
-//    std::cout << " matrix size: ";
-//    for (auto size: matrix_size) {
-//        std::cout << size << " ";
-//    }
-//    std::cout << " total cell: " << total_cell << " speaker num: " << reference.size();
+    std::vector<size_t> stride = get_stride(matrix_size);
+    std::vector<std::vector<neighbour_move>> neighbour_move_list = get_neighbour_move_list(stride);
+    stage_timer fill_timer(config.stats, &alignment_stats::fill_nanosecond);
     std::vector<int16_t> score(total_cell);
-//    auto score = std::make_unique<int[]>(total_cell);
-//    std::fill(&score[0], &score[total_cell - 1], 0);
+    std::vector<uint8_t> traceback(config.store_traceback ? total_cell : 0);
+    if (config.stats) {
+        config.stats->cell += total_cell;
+        config.stats->peak_tensor_byte = std::max(config.stats->peak_tensor_byte, score.size() * sizeof(int16_t) + traceback.size());
+    }
 
     // computing score
-    for (const std::vector<int>& sequence_position: get_sequence_position_list((int)speaker_sequence.size())) {
-        std::vector<int> current_index;
-        for (int i = 0; i < matrix_size.size(); ++i) {
-            if (std::ranges::find(sequence_position, i) == sequence_position.end()) {
-                current_index.emplace_back(0);
-            } else {
-                current_index.emplace_back(1);
+    int thread_num = get_thread_num(config.thread_num);
+    if (thread_num > 1) {
+        fill_score_wavefront(score, traceback, matrix_size, stride, neighbour_move_list, table, thread_num);
+    } else {
+        fill_score(score, traceback, matrix_size, stride, neighbour_move_list, table);
+    }
+    fill_timer.stop();
+
+    // backtracking
+    stage_timer traceback_timer(config.stats, &alignment_stats::traceback_nanosecond);
+    std::vector<int> current_index(matrix_size.size());
+    std::vector<std::vector<int>> align_index(token_id_sequence.size());
+    size_t index{total_cell - 1};
+    for (int i = 0; i < matrix_size.size(); ++i) {
+        current_index[i] = matrix_size[i] - 1;
+    }
+    while (index > 0) {
+        int mask{0};
+        for (int i = 0; i < current_index.size(); ++i) {
+            if (current_index[i] != 0) {
+                mask |= 1 << i;
             }
         }
-        while (true) {
-            std::vector<int> parameter;
-            for (const std::vector<int>& parameter_index: get_parameter_index_list(sequence_position, current_index)) {
-                std::vector<std::string> compare_parameter = get_compare_parameter(current_index, parameter_index, speaker_sequence);
-                std::string hypo = compare_parameter[0];
-                std::vector<std::string> ref(compare_parameter.begin() + 1, compare_parameter.end());
-                parameter.emplace_back(score[get_index(parameter_index, matrix_size)] + compare(hypo, ref, partial_bound));
-            }
-            score[get_index(current_index, matrix_size)] = *std::ranges::max_element(parameter);
-            current_index[sequence_position.back()]++;
-            for (int i = sequence_position.size() - 1; i >= 0; i--) {
-                if (current_index[sequence_position[0]] == matrix_size[sequence_position[0]]) {
-                    goto new_sequence_position;
+        for (int k = 0; k < neighbour_move_list[mask].size(); ++k) {
+            const neighbour_move& move = neighbour_move_list[mask][k];
+            // the stored winning move is the first move reaching the cell score, same as re-scoring the moves
+            if (!traceback.empty() ? k == traceback[index] : score[index] == get_move_score(move, current_index, table) + score[index - move.offset]) {
+                bool hypothesis_move = move.dimension == 0 || move.with_hypothesis;
+                align_index[0].emplace_back(hypothesis_move ? current_index[0] - 1 : -1);
+                for (int i = 1; i < align_index.size(); ++i) {
+                    align_index[i].emplace_back(i == move.dimension ? current_index[i] - 1 : -1);
                 }
-                if (current_index[sequence_position[i]] == matrix_size[sequence_position[i]]) {
-                    current_index[sequence_position[i - 1]]++;
-                    current_index[sequence_position[i]] = 1;
+                current_index[move.dimension]--;
+                if (move.with_hypothesis) {
+                    current_index[0]--;
                 }
+                index -= move.offset;
+                break;
             }
         }
-        new_sequence_position:;
     }
+    for (std::vector<int> &sequence : align_index) {
+        std::ranges::reverse(sequence);
+    }
+    return align_index;
+}
 
-//    std::cout << " cell max score: " << *std::ranges::max_element(score);
+std::vector<int> get_band_width(const std::vector<size_t>& sequence_length, int band_width) {
+    /*
+     * Get the band width of each separated reference for banded alignment.
+     *
+     * The band width is at least the number of reference tokens per hypothesis token (rounded up),
+     * so that the bands of two adjacent hypothesis indexes always overlap.
+     * With BAND_WIDTH_AUTO, the band width is derived from the length ratio of reference and hypothesis
+     * plus BAND_WIDTH_RATIO of the reference length (at least BAND_MIN_WIDTH).
+     *
+     * @param sequence_length: length of hypothesis and separated references
+     * @param band_width: band width from the config, positive for a fixed band width or BAND_WIDTH_AUTO
+     * @return: band width of each separated reference as vector of integers
+     */
+    int hypothesis_length = std::max<int>((int)sequence_length[0], 1);
+    std::vector<int> speaker_band_width;
+    for (int i = 1; i < sequence_length.size(); ++i) {
+        int reference_length = (int)sequence_length[i];
+        int slope = std::max(1, (reference_length + hypothesis_length - 1) / hypothesis_length);
+        if (band_width > 0) {
+            speaker_band_width.emplace_back(std::max(band_width, slope));
+        } else {
+            speaker_band_width.emplace_back(slope + std::max(BAND_MIN_WIDTH, (int)std::ceil(BAND_WIDTH_RATIO * reference_length)));
+        }
+    }
+    return speaker_band_width;
+}
 
-    // backtracking
-    std::vector<std::vector<std::string>> align_sequence(speaker_sequence.size());
-    // initialize mappings here
-    std::vector<int> current_index;
-    for (int size: matrix_size) {
-        current_index.emplace_back(size - 1);
-    }
-    while (std::accumulate(current_index.begin(), current_index.end(), 0) > 0) {
-        std::vector<int> sequence_position;
-        for (int i = 0; i < current_index.size(); ++i) {
-            if (current_index[i] != 0) {
-                sequence_position.emplace_back(i);
-            }
-        }
-        for (const std::vector<int>& parameter_index: get_parameter_index_list(sequence_position, current_index)) {
-            std::vector<std::string> compare_parameter = get_compare_parameter(current_index, parameter_index, speaker_sequence);
-            std::string hypo = compare_parameter[0];
-            std::vector<std::string> ref(compare_parameter.begin() + 1, compare_parameter.end());
-            if (score[get_index(current_index, matrix_size)] == compare(hypo, ref, partial_bound) + score[get_index(parameter_index, matrix_size)]) {
-                align_sequence[0].emplace_back(hypo);
-                for (int i = 1; i < align_sequence.size(); ++i) {
-                    align_sequence[i].emplace_back(ref[i - 1]);
-                    // update mappings here
+std::pair<int, int> get_band_range(int hypothesis_index, int hypothesis_length, int reference_length, int band_width) {
+    /*
+     * Get the first and last reference index within the band for a hypothesis index,
+     * the reference index is expected at hypothesis_index * reference_length / hypothesis_length (rounded)
+     */
+    int center = hypothesis_length > 0 ? (int)(((int64_t)2 * hypothesis_index * reference_length + hypothesis_length) / (2 * hypothesis_length)) : 0;
+    return {std::max(0, center - band_width), std::min(reference_length, center + band_width)};
+}
+
+std::vector<std::vector<int>> banded_alignment_index(const std::vector<std::vector<uint32_t>>& token_id_sequence, const score_table& table, const std::vector<int>& band_width, bool& touch_band_edge,
+                                                     alignment_stats *stats) {
+    /*
+     * Multi-sequence alignment that only stores and computes the cells within a band around the expected diagonal.
+     *
+     * For hypothesis index i, the reference index of speaker s is expected at i * |reference of s| / |hypothesis|,
+     * and only the reference indexes within the band width of the expected one are kept.
+     * The cells with the same hypothesis index form a dense slice (a box over all separated references),
+     * the slices are stored one after another in a one dimensional vector.
+     * The previous cells out of the band are not used for comparison, so the result is the best path within the band,
+     * which is the same as multi-sequence alignment only when an optimal path stays inside the band.
+     *
+     * @param token_id_sequence: token ids of hypothesis and separated references from intern_token
+     * @param table: score table from get_score_table
+     * @param band_width: band width of each separated reference from get_band_width
+     * @param touch_band_edge: output, set to true if the aligned path touches the edge of the band, which is a hint that
+     * a wider band may give a better path, a path that does not touch the edge can still be suboptimal (banded alignment is a heuristic)
+     * @param stats: time and counters of the alignment are added when it is not null
+     * @return: aligned position of each sequence as 2d vector of integers, -1 represents a gap
+     */
+    stage_timer fill_timer(stats, &alignment_stats::fill_nanosecond);
+    int hypothesis_length = (int)token_id_sequence[0].size();
+    int speaker_num = (int)token_id_sequence.size() - 1;
+    std::vector<int> reference_length;
+    for (int s = 0; s < speaker_num; ++s) {
+        reference_length.emplace_back((int)token_id_sequence[s + 1].size());
+    }
+
+    // band and layout of each slice
+    std::vector<std::vector<int>> lower(hypothesis_length + 1, std::vector<int>(speaker_num));
+    std::vector<std::vector<int>> upper(hypothesis_length + 1, std::vector<int>(speaker_num));
+    std::vector<std::vector<int64_t>> slice_stride(hypothesis_length + 1, std::vector<int64_t>(speaker_num));
+    std::vector<int64_t> slice_start(hypothesis_length + 2, 0);
+    for (int i = 0; i <= hypothesis_length; ++i) {
+        int64_t slice_cell{1};
+        for (int s = speaker_num - 1; s >= 0; --s) {
+            std::tie(lower[i][s], upper[i][s]) = get_band_range(i, hypothesis_length, reference_length[s], band_width[s]);
+            slice_stride[i][s] = slice_cell;
+            slice_cell *= upper[i][s] - lower[i][s] + 1;
+        }
+        slice_start[i + 1] = slice_start[i] + slice_cell;
+    }
+    std::vector<int16_t> score(slice_start[hypothesis_length + 1]);
+    if (stats) {
+        stats->cell += score.size();
+        stats->peak_tensor_byte = std::max(stats->peak_tensor_byte, score.size() * sizeof(int16_t));
+    }
+
+    // index of the cell with the same reference indexes in the previous slice, and the number of reference indexes out of its band
+    std::vector<int> current_index(speaker_num);
+    auto get_previous_slice_index = [&](int i, int& out_band) {
+        int64_t previous_index = slice_start[i - 1];
+        out_band = 0;
+        for (int s = 0; s < speaker_num; ++s) {
+            previous_index += (current_index[s] - lower[i - 1][s]) * slice_stride[i - 1][s];
+            out_band += current_index[s] < lower[i - 1][s] || current_index[s] > upper[i - 1][s];
+        }
+        return previous_index;
+    };
+    auto in_previous_band = [&](int i, int s, int reference_index) {
+        return reference_index >= lower[i - 1][s] && reference_index <= upper[i - 1][s];
+    };
+
+    // computing score, the slices in order of hypothesis index and the cells of each slice in lexicographic order
+    for (int i = 0; i <= hypothesis_length; ++i) {
+        current_index = lower[i];
+        for (int64_t index = slice_start[i]; index < slice_start[i + 1]; ++index) {
+            int max_score{INT_MIN};
+            int out_band{0};
+            int64_t previous_index = i > 0 ? get_previous_slice_index(i, out_band) : 0;
+            if (i > 0 && out_band == 0) {
+                max_score = score[previous_index] + GAP_SCORE;
+            }
+            for (int s = 0; s < speaker_num; ++s) {
+                if (current_index[s] == 0) {
+                    continue;
+                }
+                if (current_index[s] - 1 >= lower[i][s]) {
+                    max_score = std::max(max_score, score[index - slice_stride[i][s]] + table.get(s, -1, current_index[s] - 1));
+                }
+                if (i > 0 && in_previous_band(i, s, current_index[s] - 1) && out_band - !in_previous_band(i, s, current_index[s]) == 0) {
+                    max_score = std::max(max_score, score[previous_index - slice_stride[i - 1][s]] + table.get(s, i - 1, current_index[s] - 1));
                 }
-                current_index = parameter_index;
-                break;
+            }
+            score[index] = max_score != INT_MIN ? (int16_t)max_score : (int16_t)(index == 0 ? 0 : BAND_UNREACHABLE_SCORE);
+            for (int s = speaker_num - 1; s >= 0; --s) {
+                if (++current_index[s] <= upper[i][s]) {
+                    break;
+                }
+                current_index[s] = lower[i][s];
             }
         }
     }
-    for (std::vector<std::string> &sequence : align_sequence) {
+
+    fill_timer.stop();
+
+    // backtracking, the previous cells are checked in the same order as multi-sequence alignment
+    stage_timer traceback_timer(stats, &alignment_stats::traceback_nanosecond);
+    std::vector<std::vector<int>> align_index(speaker_num + 1);
+    int i = hypothesis_length;
+    current_index = reference_length;
+    touch_band_edge = false;
+    while (i > 0 || std::ranges::any_of(current_index, [](int j) { return j > 0; })) {
+        int64_t index = slice_start[i];
+        for (int s = 0; s < speaker_num; ++s) {
+            index += (current_index[s] - lower[i][s]) * slice_stride[i][s];
+            if ((current_index[s] == lower[i][s] && lower[i][s] > 0) || (current_index[s] == upper[i][s] && upper[i][s] < reference_length[s])) {
+                touch_band_edge = true;
+            }
+        }
+        int out_band{0};
+        int64_t previous_index = i > 0 ? get_previous_slice_index(i, out_band) : 0;
+        int move_speaker{-1};
+        bool with_hypothesis{false};
+        if (i > 0 && out_band == 0 && score[index] == score[previous_index] + GAP_SCORE) {
+            with_hypothesis = true;
+        } else {
+            for (int s = 0; s < speaker_num; ++s) {
+                if (current_index[s] == 0) {
+                    continue;
+                }
+                if (current_index[s] - 1 >= lower[i][s] && score[index] == score[index - slice_stride[i][s]] + table.get(s, -1, current_index[s] - 1)) {
+                    move_speaker = s;
+                    break;
+                }
+                if (i > 0 && in_previous_band(i, s, current_index[s] - 1) && out_band - !in_previous_band(i, s, current_index[s]) == 0
+                    && score[index] == score[previous_index - slice_stride[i - 1][s]] + table.get(s, i - 1, current_index[s] - 1)) {
+                    move_speaker = s;
+                    with_hypothesis = true;
+                    break;
+                }
+            }
+        }
+        if (move_speaker == -1 && !with_hypothesis) {
+            throw std::runtime_error("no previous cell found while backtracking banded alignment");
+        }
+        align_index[0].emplace_back(with_hypothesis ? i - 1 : -1);
+        for (int s = 0; s < speaker_num; ++s) {
+            align_index[s + 1].emplace_back(s == move_speaker ? current_index[s] - 1 : -1);
+        }
+        if (move_speaker != -1) {
+            current_index[move_speaker]--;
+        }
+        if (with_hypothesis) {
+            i--;
+        }
+    }
+    for (std::vector<int> &sequence : align_index) {
         std::ranges::reverse(sequence);
     }
+    return align_index;
+}
+
+std::vector<int> get_slice_score(const score_table& table, int hypothesis_start, int hypothesis_end, const std::vector<int>& reference_start, const std::vector<int>& reference_end, bool is_reverse) {
+    /*
+     * Calculate the scores of the last slice (cells with the same hypothesis index) of the scoring matrix
+     * for the part of the sequences between the start and end indexes, only two slices are kept in memory.
+     *
+     * The cells of a slice are all combinations of the reference indexes and are stored in lexicographic order.
+     * Without reverse, the scores are for the best path from the start of all sequences to each cell of the slice at hypothesis_end.
+     * With reverse, the sequences are aligned from end to start, and the scores are for the best path
+     * from each cell of the slice at hypothesis_start to the end of all sequences, the cell of reference index j
+     * is stored at the position of reference_end - j.
+     *
+     * @param table: score table from get_score_table
+     * @param hypothesis_start: first hypothesis index
+     * @param hypothesis_end: last hypothesis index
+     * @param reference_start: first reference index of each separated reference
+     * @param reference_end: last reference index of each separated reference
+     * @param is_reverse: if the sequences are aligned from end to start
+     * @return: scores of the last slice as vector of integers
+     */
+    int speaker_num = (int)reference_start.size();
+    std::vector<int> reference_length(speaker_num);
+    std::vector<size_t> stride(speaker_num);
+    size_t slice_cell{1};
+    for (int s = speaker_num - 1; s >= 0; --s) {
+        reference_length[s] = reference_end[s] - reference_start[s];
+        stride[s] = slice_cell;
+        slice_cell *= reference_length[s] + 1;
+    }
+    // token index consumed when moving to index k along a sequence between start and end
+    auto get_token_index = [&](int start, int end, int k) {
+        return is_reverse ? end - k : start + k - 1;
+    };
+    std::vector<int> previous(slice_cell), current(slice_cell);
+    std::vector<int> current_index(speaker_num);
+    for (int i = 0; i <= hypothesis_end - hypothesis_start; ++i) {
+        std::ranges::fill(current_index, 0);
+        int hypothesis_token = i > 0 ? get_token_index(hypothesis_start, hypothesis_end, i) : -1;
+        for (size_t index = 0; index < slice_cell; ++index) {
+            int max_score = i > 0 ? previous[index] + GAP_SCORE : (index == 0 ? 0 : INT_MIN);
+            for (int s = 0; s < speaker_num; ++s) {
+                if (current_index[s] == 0) {
+                    continue;
+                }
+                int reference_token = get_token_index(reference_start[s], reference_end[s], current_index[s]);
+                max_score = std::max(max_score, current[index - stride[s]] + table.get(s, -1, reference_token));
+                if (i > 0) {
+                    max_score = std::max(max_score, previous[index - stride[s]] + table.get(s, hypothesis_token, reference_token));
+                }
+            }
+            current[index] = max_score;
+            for (int s = speaker_num - 1; s >= 0; --s) {
+                if (++current_index[s] <= reference_length[s]) {
+                    break;
+                }
+                current_index[s] = 0;
+            }
+        }
+        std::swap(previous, current);
+    }
+    return previous;
+}
+
+void linear_memory_alignment_aux(const std::vector<std::vector<uint32_t>>& token_id_sequence, const score_table& table, int hypothesis_start, int hypothesis_end,
+                                 const std::vector<int>& reference_start, const std::vector<int>& reference_end, std::vector<std::vector<int>>& align_index, alignment_stats *stats) {
+    /*
+     * Auxiliary recursive function for linear memory alignment, align the part of the sequences between the start and end indexes
+     * and append the aligned positions to align_index, the slice scores are counted as filling and the rest as backtracking
+     */
+    int speaker_num = (int)reference_start.size();
+    size_t total_cell = hypothesis_end - hypothesis_start + 1;
+    for (int s = 0; s < speaker_num; ++s) {
+        total_cell *= reference_end[s] - reference_start[s] + 1;
+    }
+    if (hypothesis_end - hypothesis_start <= 1 || total_cell <= LINEAR_MEMORY_BASE_CELL) {
+        // small enough, align the part with the whole scoring matrix
+        std::vector<std::vector<uint32_t>> sub_token_id_sequence{{token_id_sequence[0].begin() + hypothesis_start, token_id_sequence[0].begin() + hypothesis_end}};
+        score_table sub_table;
+        sub_table.row_size = hypothesis_end - hypothesis_start + 1;
+        for (int s = 0; s < speaker_num; ++s) {
+            const std::vector<uint32_t>& reference = token_id_sequence[s + 1];
+            sub_token_id_sequence.emplace_back(reference.begin() + reference_start[s], reference.begin() + reference_end[s]);
+            std::vector<int8_t> speaker_score;
+            for (int j = reference_start[s]; j < reference_end[s]; ++j) {
+                speaker_score.emplace_back(table.get(s, -1, j));
+                for (int i = hypothesis_start; i < hypothesis_end; ++i) {
+                    speaker_score.emplace_back(table.get(s, i, j));
+                }
+            }
+            sub_table.score.emplace_back(std::move(speaker_score));
+        }
+        msa_config sub_config;
+        sub_config.stats = stats;
+        std::vector<std::vector<int>> sub_align_index = dense_alignment_index(sub_token_id_sequence, sub_table, sub_config);
+        for (int k = 0; k < sub_align_index.size(); ++k) {
+            int offset = k == 0 ? hypothesis_start : reference_start[k - 1];
+            for (int position: sub_align_index[k]) {
+                align_index[k].emplace_back(position != -1 ? position + offset : -1);
+            }
+        }
+        return;
+    }
+
+    // find the cell in the middle slice of hypothesis that the optimal path goes through
+    int hypothesis_middle = (hypothesis_start + hypothesis_end) / 2;
+    stage_timer fill_timer(stats, &alignment_stats::fill_nanosecond);
+    std::vector<int> forward = get_slice_score(table, hypothesis_start, hypothesis_middle, reference_start, reference_end, false);
+    std::vector<int> backward = get_slice_score(table, hypothesis_middle, hypothesis_end, reference_start, reference_end, true);
+    fill_timer.stop();
+    size_t slice_cell = forward.size();
+    if (stats) {
+        // both passes compute the middle slice, the forward slice is kept while the backward pass keeps two slices
+        stats->cell += (hypothesis_end - hypothesis_start + 2) * slice_cell;
+        stats->peak_tensor_byte = std::max(stats->peak_tensor_byte, 3 * slice_cell * sizeof(int));
+    }
+    stage_timer traceback_timer(stats, &alignment_stats::traceback_nanosecond);
+    size_t middle_index{0};
+    for (size_t index = 1; index < slice_cell; ++index) {
+        if (forward[index] + backward[slice_cell - 1 - index] > forward[middle_index] + backward[slice_cell - 1 - middle_index]) {
+            middle_index = index;
+        }
+    }
+    std::vector<int> reference_middle(speaker_num);
+    for (int s = speaker_num - 1; s >= 0; --s) {
+        int reference_length = reference_end[s] - reference_start[s];
+        reference_middle[s] = reference_start[s] + (int)(middle_index % (reference_length + 1));
+        middle_index /= reference_length + 1;
+    }
+    traceback_timer.stop();
+    linear_memory_alignment_aux(token_id_sequence, table, hypothesis_start, hypothesis_middle, reference_start, reference_middle, align_index, stats);
+    linear_memory_alignment_aux(token_id_sequence, table, hypothesis_middle, hypothesis_end, reference_middle, reference_end, align_index, stats);
+}
+
+std::vector<std::vector<int>> linear_memory_alignment_index(const std::vector<std::vector<uint32_t>>& token_id_sequence, const score_table& table, alignment_stats *stats) {
+    /*
+     * Exact multi-sequence alignment in divide-and-conquer way (Hirschberg's algorithm expanded to multidimensional way),
+     * which only keeps slices of the scoring matrix instead of the whole scoring matrix.
+     *
+     * The scores of the middle slice of hypothesis are calculated from the start (forward) and from the end (backward),
+     * the cell with the largest sum of the two scores is on an optimal path, so the sequences are divided at this cell
+     * and both halves are aligned recursively until they are small enough for the whole scoring matrix.
+     * The memory is reduced by the dimension of hypothesis and the time is about twice of filling the whole scoring matrix,
+     * the result has the same optimal score but may be a different path when there are multiple optimal paths.
+     *
+     * @param token_id_sequence: token ids of hypothesis and separated references (by speaker) from intern_token
+     * @param table: score table from get_score_table
+     * @param stats: time and counters of the alignment are added when it is not null
+     * @return: aligned position of each sequence as 2d vector of integers, -1 represents a gap
+     */
+    std::vector<int> reference_start(token_id_sequence.size() - 1, 0);
+    std::vector<int> reference_end;
+    for (int s = 1; s < token_id_sequence.size(); ++s) {
+        reference_end.emplace_back((int)token_id_sequence[s].size());
+    }
+    std::vector<std::vector<int>> align_index(token_id_sequence.size());
+    linear_memory_alignment_aux(token_id_sequence, table, 0, (int)token_id_sequence[0].size(), reference_start, reference_end, align_index, stats);
+    return align_index;
+}
+
+std::vector<std::vector<int>> get_suffix_gain(const score_table& table, int hypothesis_length, int reference_length, int speaker) {
+    /*
+     * Get the largest total gain of matching the hypothesis suffix from each position with the reference suffix of a speaker
+     * from each position, where the gain of a match is its score over aligning both tokens with gaps and unmatched tokens cost nothing.
+     * The suffix gain of hypothesis position i and reference position j is stored at [0][j * (hypothesis_length + 1) + i],
+     * and the total gap score of the reference suffix from position j is stored at [1][j].
+     *
+     * @param table: score table from get_score_table
+     * @param hypothesis_length: length of hypothesis
+     * @param reference_length: length of the separated reference
+     * @param speaker: index of the separated reference
+     * @return: suffix gains and suffix gap scores of the speaker
+     */
+    size_t row_size = hypothesis_length + 1;
+    std::vector<std::vector<int>> suffix{std::vector<int>((reference_length + 1) * row_size), std::vector<int>(reference_length + 1)};
+    for (int j = reference_length - 1; j >= 0; --j) {
+        int reference_gap_score = table.get(speaker, -1, j);
+        suffix[1][j] = suffix[1][j + 1] + reference_gap_score;
+        for (int i = hypothesis_length - 1; i >= 0; --i) {
+            int gain = table.get(speaker, i, j) - reference_gap_score - GAP_SCORE;
+            suffix[0][j * row_size + i] = std::max({suffix[0][j * row_size + i + 1], suffix[0][(j + 1) * row_size + i],
+                                                    suffix[0][(j + 1) * row_size + i + 1] + gain});
+        }
+    }
+    return suffix;
+}
+
+std::vector<std::vector<int>> astar_alignment_index(const std::vector<std::vector<uint32_t>>& token_id_sequence, const score_table& table, size_t max_memory_bytes,
+                                                    bool& is_over_budget, alignment_stats *stats) {
+    /*
+     * Exact multi-sequence alignment by A* search over the cells of the scoring matrix, only the cells reached by the search
+     * are kept in a hash set instead of filling the whole scoring matrix.
+     *
+     * The remaining score from a cell is bounded by the gaps of all remaining tokens plus the sum of the suffix gains
+     * of the pairwise alignments of the remaining hypothesis with the remaining reference of each speaker (Carrillo-Lipman bound),
+     * which never underestimates the remaining score and never decreases by more than the score of a move, so the first time
+     * the end of all sequences is taken from the queue, its path is optimal. When the optimal path is close to the pairwise paths,
+     * which is the case for well matching input, the search only reaches the cells near the optimal path.
+     * The result has the same optimal score as the other exact engines but may be a different path when there are multiple optimal paths.
+     *
+     * @param token_id_sequence: token ids of hypothesis and separated references (by speaker) from intern_token
+     * @param table: score table from get_score_table
+     * @param max_memory_bytes: memory budget of the search including the score table in bytes, 0 for no limit, see get_astar_byte
+     * @param is_over_budget: set to true if the search is stopped because the reached cells exceed the budget, the result is empty then
+     * @param stats: time and counters of the alignment are added when it is not null
+     * @return: aligned position of each sequence as 2d vector of integers, -1 represents a gap
+     */
+    int dimension = (int)token_id_sequence.size();
+    int hypothesis_length = (int)token_id_sequence[0].size();
+    size_t row_size = hypothesis_length + 1;
+    is_over_budget = false;
+
+    stage_timer fill_timer(stats, &alignment_stats::fill_nanosecond);
+    std::vector<std::vector<std::vector<int>>> suffix;
+    size_t suffix_cell{0};
+    for (int s = 1; s < dimension; ++s) {
+        suffix.emplace_back(get_suffix_gain(table, hypothesis_length, (int)token_id_sequence[s].size(), s - 1));
+        suffix_cell += suffix.back()[0].size();
+    }
+    std::vector<size_t> sequence_length = get_sequence_length(token_id_sequence);
+    auto get_heuristic = [&](const int *position) {
+        int heuristic = (hypothesis_length - position[0]) * GAP_SCORE;
+        for (int s = 1; s < dimension; ++s) {
+            heuristic += suffix[s - 1][1][position[s]] + suffix[s - 1][0][position[s] * row_size + position[0]];
+        }
+        return heuristic;
+    };
+
+    // position of each reached cell is stored one after another, the cells are identified by their order of reaching
+    std::vector<int> node_position(dimension, 0);
+    std::vector<int> node_score{0}, node_parent{-1};
+    std::vector<bool> is_closed{false};
+    auto get_position = [&](int node) {
+        return node_position.data() + (size_t)node * dimension;
+    };
+    auto hash = [&](int node) {
+        const int *position = get_position(node);
+        size_t seed{0};
+        for (int d = 0; d < dimension; ++d) {
+            seed ^= (size_t)position[d] + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2);
+        }
+        return seed;
+    };
+    auto equal = [&](int node1, int node2) {
+        return std::equal(get_position(node1), get_position(node1) + dimension, get_position(node2));
+    };
+    std::unordered_set<int, decltype(hash), decltype(equal)> node_set(1024, hash, equal);
+    node_set.insert(0);
+    // reached cells ordered by the bound of the total score, then by the number of consumed tokens, so that the search goes deep
+    // among the many orders of the same moves with the same bound
+    std::priority_queue<std::tuple<int, int, int, int>> open_list;
+    open_list.emplace(get_heuristic(get_position(0)), 0, 0, 0);
+    std::vector<int> current(dimension), next(dimension);
+    int end_node{-1};
+    while (!open_list.empty()) {
+        auto [bound, depth, score, node] = open_list.top();
+        open_list.pop();
+        if (is_closed[node] || score < node_score[node]) {
+            continue;
+        }
+        is_closed[node] = true;
+        // an expansion reaches at most 2 * dimension - 1 new cells
+        if (max_memory_bytes != 0 && get_astar_byte(sequence_length, node_score.size() + 2 * dimension - 1) > max_memory_bytes) {
+            is_over_budget = true;
+            break;
+        }
+        std::copy(get_position(node), get_position(node) + dimension, current.begin());
+        bool is_end = current[0] == hypothesis_length;
+        for (int s = 1; s < dimension; ++s) {
+            is_end = is_end && current[s] == token_id_sequence[s].size();
+        }
+        if (is_end) {
+            end_node = node;
+            break;
+        }
+        auto reach = [&](int move_score, int move_depth) {
+            int next_node = (int)node_score.size();
+            node_position.insert(node_position.end(), next.begin(), next.end());
+            auto [it, is_new] = node_set.insert(next_node);
+            if (!is_new) {
+                node_position.resize(node_position.size() - dimension);
+                next_node = *it;
+                if (is_closed[next_node] || score + move_score <= node_score[next_node]) {
+                    return;
+                }
+                node_score[next_node] = score + move_score;
+                node_parent[next_node] = node;
+            } else {
+                node_score.emplace_back(score + move_score);
+                node_parent.emplace_back(node);
+                is_closed.push_back(false);
+            }
+            open_list.emplace(score + move_score + get_heuristic(get_position(next_node)), depth + move_depth, score + move_score, next_node);
+        };
+        next = current;
+        if (current[0] < hypothesis_length) {
+            ++next[0];
+            reach(GAP_SCORE, 1);
+        }
+        for (int s = 1; s < dimension; ++s) {
+            if (current[s] == token_id_sequence[s].size()) {
+                continue;
+            }
+            next = current;
+            ++next[s];
+            reach(table.get(s - 1, -1, current[s]), 1);
+            if (current[0] < hypothesis_length) {
+                ++next[0];
+                reach(table.get(s - 1, current[0], current[s]), 2);
+            }
+        }
+    }
+    fill_timer.stop();
+    if (stats) {
+        stats->cell += suffix_cell + node_score.size();
+        stats->peak_tensor_byte = std::max(stats->peak_tensor_byte, get_astar_byte(sequence_length, node_score.size()));
+    }
+    if (is_over_budget) {
+        return {};
+    }
+
+    stage_timer traceback_timer(stats, &alignment_stats::traceback_nanosecond);
+    std::vector<std::vector<int>> align_index(dimension);
+    for (int node = end_node; node_parent[node] != -1; node = node_parent[node]) {
+        const int *position = get_position(node);
+        const int *previous_position = get_position(node_parent[node]);
+        for (int d = 0; d < dimension; ++d) {
+            align_index[d].emplace_back(position[d] != previous_position[d] ? previous_position[d] : -1);
+        }
+    }
+    for (std::vector<int>& sequence: align_index) {
+        std::ranges::reverse(sequence);
+    }
+    return align_index;
+}
+
+std::vector<int> pairwise_alignment_index(const score_table& table, int speaker, int reference_length, const std::vector<int>& owner, alignment_stats *stats) {
+    /*
+     * Align the hypothesis with the separated reference of a single speaker by the pairwise Needleman-Wunsch algorithm,
+     * with the same scores as the multi-sequence alignment. A hypothesis token owned by another speaker can only be skipped,
+     * which costs nothing since the token is aligned in the column of the other speaker.
+     *
+     * @param table: score table from get_score_table
+     * @param speaker: index of the separated reference
+     * @param reference_length: length of the separated reference
+     * @param owner: speaker owning each hypothesis token, -1 if the token is not owned by any speaker
+     * @param stats: time and counters of the alignment are added when it is not null
+     * @return: matched hypothesis position of each reference token, -1 if the reference token is aligned with a gap
+     */
+    int hypothesis_length = (int)owner.size();
+    size_t row_size = hypothesis_length + 1;
+    // winning move of each cell, 0 for hypothesis with reference, 1 for hypothesis alone and 2 for reference alone
+    std::vector<uint8_t> move((reference_length + 1) * row_size);
+    std::vector<int> previous(row_size), current(row_size);
+    auto is_blocked = [&](int i) {
+        return owner[i] != -1 && owner[i] != speaker;
+    };
+    stage_timer fill_timer(stats, &alignment_stats::fill_nanosecond);
+    for (int i = 1; i <= hypothesis_length; ++i) {
+        previous[i] = previous[i - 1] + (is_blocked(i - 1) ? 0 : GAP_SCORE);
+        move[i] = 1;
+    }
+    for (int j = 1; j <= reference_length; ++j) {
+        int reference_gap_score = table.get(speaker, -1, j - 1);
+        current[0] = previous[0] + reference_gap_score;
+        move[j * row_size] = 2;
+        for (int i = 1; i <= hypothesis_length; ++i) {
+            bool blocked = is_blocked(i - 1);
+            int max_score = previous[i - 1] + table.get(speaker, i - 1, j - 1);
+            uint8_t max_move{0};
+            if (blocked || current[i - 1] + GAP_SCORE > max_score) {
+                max_score = current[i - 1] + (blocked ? 0 : GAP_SCORE);
+                max_move = 1;
+            }
+            if (previous[i] + reference_gap_score > max_score) {
+                max_score = previous[i] + reference_gap_score;
+                max_move = 2;
+            }
+            current[i] = max_score;
+            move[j * row_size + i] = max_move;
+        }
+        std::swap(previous, current);
+    }
+    fill_timer.stop();
+    if (stats) {
+        stats->cell += move.size();
+        stats->peak_tensor_byte = std::max(stats->peak_tensor_byte, move.size() * sizeof(uint8_t) + 2 * row_size * sizeof(int));
+    }
+
+    stage_timer traceback_timer(stats, &alignment_stats::traceback_nanosecond);
+    std::vector<int> match(reference_length, -1);
+    for (int i = hypothesis_length, j = reference_length; i > 0 || j > 0;) {
+        uint8_t current_move = move[j * row_size + i];
+        if (current_move == 0) {
+            --i;
+            --j;
+            match[j] = i;
+        } else if (current_move == 1) {
+            --i;
+        } else {
+            --j;
+        }
+    }
+    return match;
+}
+
+std::vector<std::vector<int>> progressive_alignment_index(const std::vector<std::vector<uint32_t>>& token_id_sequence, const score_table& table, alignment_stats *stats) {
+    /*
+     * Approximate multi-sequence alignment in polynomial time, the cost is about the length of hypothesis times
+     * the total length of the separated references instead of the product of the lengths of all sequences.
+     *
+     * Each separated reference is aligned with the hypothesis by pairwise alignment. When several speakers claim the same
+     * hypothesis token, the token is given to the speaker with the largest gain of the match over aligning both tokens with gaps,
+     * or the largest total gain of its matches within PROGRESSIVE_CONTEXT_RADIUS tokens when the gains are equal.
+     * The speakers losing any token are aligned again with the tokens owned by the other speakers skipped,
+     * until there is no conflict or after PROGRESSIVE_MAX_ROUND rounds, when the remaining lost matches are aligned with gaps.
+     * The unmatched reference tokens of a speaker follow its previous matched token, or precede its first one.
+     *
+     * @param token_id_sequence: token ids of hypothesis and separated references (by speaker) from intern_token
+     * @param table: score table from get_score_table
+     * @param stats: time and counters of the alignment are added when it is not null
+     * @return: aligned position of each sequence as 2d vector of integers in the same format as the exact engines, -1 represents a gap
+     */
+    int hypothesis_length = (int)token_id_sequence[0].size();
+    int speaker_num = (int)token_id_sequence.size() - 1;
+    std::vector<std::vector<int>> match(speaker_num);
+    std::vector<std::vector<int>> claim(speaker_num, std::vector<int>(hypothesis_length, -1));  // matched reference position of each hypothesis token
+    std::vector<int> owner(hypothesis_length, -1);
+    std::vector<bool> is_pending(speaker_num, true);
+    auto get_gain = [&](int s, int i) {
+        int j = claim[s][i];
+        return j != -1 ? table.get(s, i, j) - table.get(s, -1, j) - GAP_SCORE : 0;
+    };
+    for (int round = 1;; ++round) {
+        for (int s = 0; s < speaker_num; ++s) {
+            if (!is_pending[s]) {
+                continue;
+            }
+            match[s] = pairwise_alignment_index(table, s, (int)token_id_sequence[s + 1].size(), owner, stats);
+            std::ranges::fill(claim[s], -1);
+            for (int j = 0; j < match[s].size(); ++j) {
+                if (match[s][j] != -1) {
+                    claim[s][match[s][j]] = j;
+                }
+            }
+        }
+
+        stage_timer traceback_timer(stats, &alignment_stats::traceback_nanosecond);
+        std::fill(is_pending.begin(), is_pending.end(), false);
+        bool has_conflict{false};
+        for (int i = 0; i < hypothesis_length; ++i) {
+            owner[i] = -1;
+            int claim_num{0};
+            for (int s = 0; s < speaker_num; ++s) {
+                if (claim[s][i] != -1) {
+                    owner[i] = s;
+                    ++claim_num;
+                }
+            }
+            if (claim_num <= 1) {
+                continue;
+            }
+            owner[i] = -1;
+            std::pair<int, int> max_key;
+            for (int s = 0; s < speaker_num; ++s) {
+                if (claim[s][i] == -1) {
+                    continue;
+                }
+                std::pair<int, int> key{get_gain(s, i), 0};
+                for (int k = std::max(0, i - PROGRESSIVE_CONTEXT_RADIUS); k <= std::min(hypothesis_length - 1, i + PROGRESSIVE_CONTEXT_RADIUS); ++k) {
+                    key.second += get_gain(s, k);
+                }
+                if (owner[i] == -1 || key > max_key) {
+                    owner[i] = s;
+                    max_key = key;
+                }
+            }
+            for (int s = 0; s < speaker_num; ++s) {
+                is_pending[s] = is_pending[s] || (claim[s][i] != -1 && s != owner[i]);
+            }
+            has_conflict = true;
+        }
+        if (!has_conflict) {
+            break;
+        }
+        if (round == PROGRESSIVE_MAX_ROUND) {
+            for (int s = 0; s < speaker_num; ++s) {
+                for (int i = 0; i < hypothesis_length; ++i) {
+                    if (claim[s][i] != -1 && owner[i] != s) {
+                        match[s][claim[s][i]] = -1;
+                        claim[s][i] = -1;
+                    }
+                }
+            }
+            break;
+        }
+    }
+
+    stage_timer traceback_timer(stats, &alignment_stats::traceback_nanosecond);
+    std::vector<std::vector<int>> align_index(speaker_num + 1);
+    auto add_column = [&](int hypothesis_position, int speaker, int reference_position) {
+        for (std::vector<int>& sequence: align_index) {
+            sequence.emplace_back(-1);
+        }
+        align_index[0].back() = hypothesis_position;
+        if (speaker != -1) {
+            align_index[speaker + 1].back() = reference_position;
+        }
+    };
+    std::vector<int> next_reference(speaker_num, 0);
+    for (int i = 0; i < hypothesis_length; ++i) {
+        int s = owner[i];
+        if (s == -1) {
+            add_column(i, -1, -1);
+            continue;
+        }
+        while (next_reference[s] < claim[s][i]) {
+            add_column(-1, s, next_reference[s]++);
+        }
+        add_column(i, s, next_reference[s]++);
+        while (next_reference[s] < match[s].size() && match[s][next_reference[s]] == -1) {
+            add_column(-1, s, next_reference[s]++);
+        }
+    }
+    for (int s = 0; s < speaker_num; ++s) {
+        while (next_reference[s] < match[s].size()) {
+            add_column(-1, s, next_reference[s]++);
+        }
+    }
+    return align_index;
+}
+
+int get_alignment_score(const std::vector<std::vector<int>>& align_index, const score_table& table) {
+    /*
+     * Get the total score of an aligned result from the score table, which is the score maximized by the exact engines
+     *
+     * @param align_index: aligned position of each sequence from multi_sequence_alignment_index
+     * @param table: score table used by the alignment
+     * @return: sum of the scores of all columns
+     */
+    int score{0};
+    for (int c = 0; c < align_index[0].size(); ++c) {
+        int column_score = GAP_SCORE;
+        for (int s = 1; s < align_index.size(); ++s) {
+            if (align_index[s][c] != -1) {
+                column_score = table.get(s - 1, align_index[0][c], align_index[s][c]);
+                break;
+            }
+        }
+        score += column_score;
+    }
+    return score;
+}
+
+void check_exact_score(const std::vector<std::vector<uint32_t>>& token_id_sequence, const score_table& table, const std::vector<std::vector<int>>& align_index, const msa_config& config) {
+    /*
+     * Align again with the exact engine when its scoring matrix has at most PROGRESSIVE_EXACT_CHECK_CELL cells and fits
+     * in the memory budget, and add the gap between the optimal score and the score of the approximate result to the stats
+     *
+     * @param token_id_sequence: token ids of hypothesis and separated references (by speaker) from intern_token
+     * @param table: score table from get_score_table
+     * @param align_index: aligned position of each sequence from progressive_alignment_index
+     * @param config: options of the alignment engine with stats
+     */
+    double total_cell{1};
+    for (const std::vector<uint32_t>& sequence: token_id_sequence) {
+        total_cell *= (double)sequence.size() + 1;
+    }
+    msa_config exact_config = config;
+    exact_config.engine = msa_engine::dense;
+    exact_config.band_width = 0;
+    exact_config.stats = nullptr;
+    if (config.stats == nullptr || total_cell > (double)PROGRESSIVE_EXACT_CHECK_CELL
+        || (config.max_memory_bytes != 0 && get_alignment_cost(get_sequence_length(token_id_sequence), exact_config).byte > config.max_memory_bytes)) {
+        return;
+    }
+    stage_timer exact_check_timer(config.stats, &alignment_stats::exact_check_nanosecond);
+    std::vector<std::vector<int>> exact_align_index = dense_alignment_index(token_id_sequence, table, exact_config);
+    config.stats->exact_check_segment += 1;
+    config.stats->score_gap += get_alignment_score(exact_align_index, table) - get_alignment_score(align_index, table);
+}
+
+std::vector<size_t> get_sequence_length(const std::vector<std::vector<uint32_t>>& token_id_sequence) {
+    /*
+     * Get the length of hypothesis and each separated reference
+     */
+    std::vector<size_t> sequence_length;
+    for (const std::vector<uint32_t>& sequence: token_id_sequence) {
+        sequence_length.emplace_back(sequence.size());
+    }
+    return sequence_length;
+}
+
+size_t get_banded_cell(const std::vector<size_t>& sequence_length, const std::vector<int>& band_width) {
+    /*
+     * Get the number of cells within the band of banded alignment
+     *
+     * @param sequence_length: length of hypothesis and separated references
+     * @param band_width: band width of each separated reference from get_band_width
+     * @return: number of cells computed by banded_alignment_index
+     */
+    size_t band_cell{0};
+    for (int i = 0; i <= sequence_length[0]; ++i) {
+        size_t slice_cell{1};
+        for (size_t s = 1; s < sequence_length.size(); ++s) {
+            auto [lower, upper] = get_band_range(i, (int)sequence_length[0], (int)sequence_length[s], band_width[s - 1]);
+            slice_cell *= upper - lower + 1;
+        }
+        band_cell += slice_cell;
+    }
+    return band_cell;
+}
+
+size_t get_banded_byte(const std::vector<size_t>& sequence_length, size_t band_cell) {
+    /*
+     * Get the memory of banded alignment in bytes, the scores of all cells within the band and the band and layout of each slice
+     */
+    size_t speaker_num = sequence_length.size() - 1;
+    return band_cell * sizeof(int16_t) + (sequence_length[0] + 1) * (speaker_num * (2 * sizeof(int) + sizeof(int64_t)) + sizeof(int64_t));
+}
+
+size_t get_astar_byte(const std::vector<size_t>& sequence_length, size_t node_num) {
+    /*
+     * Get the memory of the A* search in bytes, the score table, the suffix gains of every speaker and the reached cells,
+     * the same for the estimate before the search and the budget check during the search
+     */
+    size_t speaker_num = sequence_length.size() - 1;
+    size_t table_byte{0};
+    size_t suffix_cell{0};
+    for (size_t s = 1; s < sequence_length.size(); ++s) {
+        table_byte += sequence_length[s] * (sequence_length[0] + 1);
+        suffix_cell += (sequence_length[0] + 1) * (sequence_length[s] + 1);
+    }
+    return table_byte + suffix_cell * sizeof(int) + node_num * ((speaker_num + 1) * sizeof(int) + ASTAR_NODE_BYTE);
+}
+
+alignment_cost get_alignment_cost(const std::vector<size_t>& sequence_length, const msa_config& config) {
+    /*
+     * Predict the number of computed cells, the peak memory and the running time of a multi-sequence alignment
+     * with the engine selected by the config, without any allocation.
+     *
+     * The memory includes the score table and the scoring matrix (or the parts of it kept by banded and linear memory alignment),
+     * the running time is based on ESTIMATED_NANOSECOND_PER_MOVE for each move compared in each cell.
+     * For banded alignment, only the first pass with the initial band width is counted.
+     *
+     * @param sequence_length: length of hypothesis and separated references
+     * @param config: options of the alignment engine
+     * @return: predicted cost of the alignment
+     */
+    size_t hypothesis_length = sequence_length[0];
+    size_t speaker_num = sequence_length.size() - 1;
+    size_t total_cell{hypothesis_length + 1};
+    size_t slice_cell{1};
+    size_t table_byte{0};
+    for (size_t s = 1; s < sequence_length.size(); ++s) {
+        slice_cell *= sequence_length[s] + 1;
+        table_byte += sequence_length[s] * (hypothesis_length + 1);
+    }
+    total_cell *= slice_cell;
+
+    alignment_cost cost;
+    cost.engine = config.engine;
+    if (config.engine == msa_engine::progressive) {
+        // every separated reference is aligned with the hypothesis once, the speakers realigned after a conflict are not counted
+        size_t max_pair_cell{0};
+        for (size_t s = 1; s < sequence_length.size(); ++s) {
+            size_t pair_cell = (hypothesis_length + 1) * (sequence_length[s] + 1);
+            cost.cell += pair_cell;
+            max_pair_cell = std::max(max_pair_cell, pair_cell);
+        }
+        cost.byte = table_byte + max_pair_cell * sizeof(uint8_t) + (2 * (hypothesis_length + 1) + speaker_num * hypothesis_length) * sizeof(int);
+    } else if (config.engine == msa_engine::astar) {
+        // the suffix gains of every speaker, and the search is assumed to reach only the cells next to the optimal path,
+        // which holds for well matching input, the search reaches more cells otherwise
+        size_t suffix_cell{0};
+        for (size_t s = 1; s < sequence_length.size(); ++s) {
+            suffix_cell += (hypothesis_length + 1) * (sequence_length[s] + 1);
+        }
+        size_t node_num = std::accumulate(sequence_length.begin(), sequence_length.end(), (size_t)1) * (2 * speaker_num + 1);
+        cost.cell = suffix_cell + node_num;
+        cost.byte = get_astar_byte(sequence_length, node_num);
+    } else if (config.engine == msa_engine::linear_memory) {
+        // both halves of each level are filled forward and backward, and at most three slices are kept at the same time
+        cost.cell = total_cell <= LINEAR_MEMORY_BASE_CELL ? total_cell : 2 * total_cell;
+        cost.byte = table_byte + std::min(total_cell, (size_t)LINEAR_MEMORY_BASE_CELL) * sizeof(int16_t)
+                    + (total_cell <= LINEAR_MEMORY_BASE_CELL ? 0 : 3 * slice_cell * sizeof(int));
+    } else {
+        bool is_full_band{true};
+        std::vector<int> band_width;
+        if (config.band_width != 0) {
+            band_width = get_band_width(sequence_length, config.band_width);
+            for (size_t s = 0; s < speaker_num; ++s) {
+                is_full_band = is_full_band && band_width[s] >= sequence_length[s + 1];
+            }
+        }
+        if (is_full_band) {
+            cost.cell = total_cell;
+            cost.byte = table_byte + total_cell * (sizeof(int16_t) + (config.store_traceback ? sizeof(uint8_t) : 0));
+        } else {
+            cost.band_width = config.band_width;
+            cost.cell = get_banded_cell(sequence_length, band_width);
+            cost.byte = table_byte + get_banded_byte(sequence_length, cost.cell);
+        }
+    }
+    int thread_num = config.engine == msa_engine::dense && config.band_width == 0 ? get_thread_num(config.thread_num) : 1;
+    size_t move_num = config.engine == msa_engine::progressive ? 3 : 2 * speaker_num + 1;
+    cost.second = (double)cost.cell * (double)move_num * ESTIMATED_NANOSECOND_PER_MOVE * 1e-9 / thread_num;
+    return cost;
+}
+
+msa_config plan_alignment(const std::vector<size_t>& sequence_length, const msa_config& config) {
+    /*
+     * Check the predicted memory of the alignment against max_memory_bytes of the config before allocating anything.
+     * If the selected engine is over the budget, the linear memory engine is used instead when it fits in the budget,
+     * which gives a result with the same optimal score. The progressive engine has no fallback.
+     *
+     * @param sequence_length: length of hypothesis and separated references
+     * @param config: options of the alignment engine
+     * @return: options of the alignment engine that fit in the budget
+     * @throw: memory_budget_error if no engine fits in the budget
+     */
+    if (config.max_memory_bytes == 0) {
+        return config;
+    }
+    alignment_cost cost = get_alignment_cost(sequence_length, config);
+    if (cost.byte <= config.max_memory_bytes) {
+        return config;
+    }
+    if (config.engine == msa_engine::progressive) {
+        throw memory_budget_error("alignment needs " + std::to_string(cost.byte) + " bytes of memory, exceeding the budget of "
+                                  + std::to_string(config.max_memory_bytes) + " bytes");
+    }
+    msa_config linear_memory_config = config;
+    linear_memory_config.engine = msa_engine::linear_memory;
+    alignment_cost linear_memory_cost = get_alignment_cost(sequence_length, linear_memory_config);
+    if (linear_memory_cost.byte <= config.max_memory_bytes) {
+        return linear_memory_config;
+    }
+    throw memory_budget_error("alignment needs " + std::to_string(linear_memory_cost.byte) + " bytes of memory, exceeding the budget of "
+                              + std::to_string(config.max_memory_bytes) + " bytes");
+}
+
+std::vector<token_match_type> get_column_match(const std::vector<std::vector<int>>& align_index, const score_table& table) {
+    /*
+     * Get the match type of each aligned column from the score table used by the alignment, so that the match result
+     * is the one decided by the dynamic programming and no token is compared again.
+     * A column has at most one reference token, it is a gap unless it also has a hypothesis token.
+     *
+     * @param align_index: aligned position of each sequence from multi_sequence_alignment_index
+     * @param table: score table used by the alignment
+     * @return: match type of each column
+     */
+    std::vector<token_match_type> column_match(align_index[0].size(), token_match_type::gap);
+    for (int c = 0; c < align_index[0].size(); ++c) {
+        if (align_index[0][c] == -1) {
+            continue;
+        }
+        for (int s = 1; s < align_index.size(); ++s) {
+            if (align_index[s][c] != -1) {
+                int score = table.get(s - 1, align_index[0][c], align_index[s][c]);
+                column_match[c] = score == FULLY_MATCH_SCORE ? token_match_type::fully_match
+                                : score == PARTIAL_MATCH_SCORE ? token_match_type::partially_match : token_match_type::mismatch;
+                break;
+            }
+        }
+    }
+    return column_match;
+}
+
+std::vector<std::vector<int>> multi_sequence_alignment_index(const std::vector<std::vector<uint32_t>>& token_id_sequence, const score_table& table, const msa_config& config) {
+    /*
+     * Multi-sequence alignment on token ids with the engine selected by the config.
+     *
+     * The linear memory engine uses divide-and-conquer alignment. The A* engine searches the scoring matrix from the start
+     * and switches to the linear memory engine when the reached cells exceed max_memory_bytes. The progressive engine gives an approximate result from
+     * pairwise alignments, and with stats, the score gap against the exact engine is added when the exact engine is affordable. Otherwise, without band width, the whole scoring matrix is filled.
+     * With band width, the banded alignment is used, and the band width is doubled and the alignment is redone
+     * as long as the aligned path touches the edge of the band, until the band covers the whole scoring matrix.
+     * A path that avoids the edge is only optimal within the band, so the result may be suboptimal, which is counted
+     * in band_limited_segment of the stats together with the final band width.
+     * With max_memory_bytes, an engine over the budget is replaced by the linear memory engine, or memory_budget_error is thrown
+     * when even the linear memory engine does not fit.
+     *
+     * @param token_id_sequence: token ids of hypothesis and separated references (by speaker) from intern_token
+     * @param table: score table from get_score_table
+     * @param config: options of the alignment engine
+     * @return: aligned position of each sequence as 2d vector of integers, each integer is the index of the token
+     * in its own sequence, -1 represents a gap
+     */
+    std::vector<size_t> sequence_length = get_sequence_length(token_id_sequence);
+    if (config.engine == msa_engine::linear_memory) {
+        plan_alignment(sequence_length, config);
+        return linear_memory_alignment_index(token_id_sequence, table, config.stats);
+    }
+    if (config.engine == msa_engine::astar) {
+        if (plan_alignment(sequence_length, config).engine == msa_engine::astar) {
+            bool is_over_budget;
+            std::vector<std::vector<int>> align_index = astar_alignment_index(token_id_sequence, table, config.max_memory_bytes, is_over_budget, config.stats);
+            if (!is_over_budget) {
+                return align_index;
+            }
+            // the search reached more cells than the budget, use the linear memory engine if it fits in the budget
+            msa_config linear_memory_config = config;
+            linear_memory_config.engine = msa_engine::linear_memory;
+            plan_alignment(sequence_length, linear_memory_config);
+        }
+        return linear_memory_alignment_index(token_id_sequence, table, config.stats);
+    }
+    if (config.engine == msa_engine::progressive) {
+        plan_alignment(sequence_length, config);
+        std::vector<std::vector<int>> align_index = progressive_alignment_index(token_id_sequence, table, config.stats);
+        check_exact_score(token_id_sequence, table, align_index, config);
+        return align_index;
+    }
+    if (config.band_width != 0) {
+        std::vector<int> band_width = get_band_width(sequence_length, config.band_width);
+        while (true) {
+            bool is_full_band{true};
+            for (int s = 0; s < band_width.size(); ++s) {
+                is_full_band = is_full_band && band_width[s] >= token_id_sequence[s + 1].size();
+            }
+            if (is_full_band) {
+                break;
+            }
+            if (config.max_memory_bytes != 0 && get_banded_byte(sequence_length, get_banded_cell(sequence_length, band_width)) > config.max_memory_bytes) {
+                break; // the band does not fit in the memory budget, leave it to the exact engines
+            }
+            bool touch_band_edge;
+            std::vector<std::vector<int>> align_index = banded_alignment_index(token_id_sequence, table, band_width, touch_band_edge, config.stats);
+            if (!touch_band_edge) {
+                if (config.stats) {
+                    config.stats->band_limited_segment += 1;
+                    config.stats->band_width = std::max(config.stats->band_width, std::ranges::max(band_width));
+                }
+                return align_index;
+            }
+            for (int& width: band_width) {
+                width *= 2;
+            }
+        }
+    }
+    msa_config dense_config = config;
+    dense_config.band_width = 0;
+    if (plan_alignment(sequence_length, dense_config).engine == msa_engine::linear_memory) {
+        return linear_memory_alignment_index(token_id_sequence, table, config.stats);
+    }
+    return dense_alignment_index(token_id_sequence, table, config);
+}
+
+std::vector<std::vector<std::string>> multi_sequence_alignment(const std::vector<std::string>& hypothesis, const std::vector<std::vector<std::string>>& reference, int partial_bound, const msa_config& config) {
+    /*
+     * Multi-sequence alignment on tokens, the tokens are interned to integer ids and all comparison scores are
+     * precomputed before the alignment, the tokens are only converted back to strings when the aligned sequences are built.
+     *
+     * @param hypothesis: sequence of tokens for hypothesis as vector of strings
+     * @param reference: sequences of tokens for separated references (by speaker) as 2d vector of strings
+     * @param partial_bound: upper bound (exclusive) of edit distance for two tokens to be partially matched
+     * @param config: options of the alignment engine
+     * @return: aligned hypothesis and separated references as 2d vector of strings
+     */
+    // check the memory budget before the score table is allocated
+    std::vector<size_t> sequence_length{hypothesis.size()};
+    for (const std::vector<std::string>& speaker: reference) {
+        sequence_length.emplace_back(speaker.size());
+    }
+    plan_alignment(sequence_length, config);
+
+    stage_timer score_table_timer(config.stats, &alignment_stats::score_table_nanosecond);
+    std::vector<std::string_view> vocabulary;
+    std::vector<std::vector<uint32_t>> token_id_sequence = intern_token(hypothesis, reference, vocabulary);
+    score_table table = get_score_table(token_id_sequence, vocabulary, partial_bound);
+    add_score_table_stats(config.stats, table);
+    score_table_timer.stop();
+    std::vector<std::vector<int>> align_index = multi_sequence_alignment_index(token_id_sequence, table, config);
+    std::vector<std::vector<std::string>> align_sequence(align_index.size());
+    for (int i = 0; i < align_index.size(); ++i) {
+        const std::vector<std::string>& sequence = i == 0 ? hypothesis : reference[i - 1];
+        align_sequence[i].reserve(align_index[i].size());
+        for (int position: align_index[i]) {
+            align_sequence[i].emplace_back(position != -1 ? sequence[position] : GAP);
+        }
+    }
     return align_sequence;
 }
 
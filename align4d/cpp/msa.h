@@ -3,16 +3,176 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #define FULLY_MATCH_SCORE 2
 #define PARTIAL_MATCH_SCORE 1
 #define MISMATCH_SCORE (-1)
 #define GAP_SCORE (-1)
 #define GAP "-"
+#define GAP_ID 0
+#define EDIT_DISTANCE_MAX_BAND_RADIUS 64
+#define BAND_WIDTH_AUTO (-1)
+#define BAND_MIN_WIDTH 4
+#define BAND_WIDTH_RATIO 0.1
+#define BAND_UNREACHABLE_SCORE (-16384)
+#define LINEAR_MEMORY_BASE_CELL (1 << 16)
+#define ESTIMATED_NANOSECOND_PER_MOVE 5.0
+#define ASTAR_NODE_BYTE 64
+#define PROGRESSIVE_MAX_ROUND 8
+#define PROGRESSIVE_CONTEXT_RADIUS 2
+#define PROGRESSIVE_EXACT_CHECK_CELL ((size_t)1 << 24)
 
-int edit_distance(const std::string &, const std::string &);
+struct score_table {
+    /*
+     * Comparison score between each hypothesis position and each reference position of every separated reference,
+     * the score of reference position j of speaker s against hypothesis position i is stored at score[s][j * row_size + i + 1],
+     * the hypothesis position -1 is a GAP as hypothesis.
+     */
+    size_t row_size{0};
+    std::vector<std::vector<int8_t>> score;
+    size_t compare_call{0};         // distinct token pairs compared by get_score_table
+    size_t edit_distance_call{0};   // edit distances computed for the comparisons
+
+    int get(int speaker, int hypothesis_index, int reference_index) const {
+        return score[speaker][reference_index * row_size + hypothesis_index + 1];
+    }
+};
+
+// decide if a hypothesis token id and a different reference token id are partially matched, used for integer token input
+typedef std::function<bool(uint32_t, uint32_t)> partial_match_function;
+
+enum class msa_engine {
+    dense,          // fill the whole scoring matrix
+    linear_memory,  // divide-and-conquer alignment keeping only slices of the scoring matrix
+    astar,          // A* search keeping only the cells of the scoring matrix reached from the start
+    progressive     // approximate alignment from pairwise alignments of the hypothesis with each separated reference
+};
+
+struct alignment_stats {
+    /*
+     * Time of each stage in nanoseconds and counters of an alignment, filled when the stats of msa_config is set,
+     * the times and counters of all segments (or jobs) are added up, even if they are aligned in parallel
+     */
+    long long segmentation_nanosecond{0};       // get_segment_index, including the barrier table
+    long long parameter_search_nanosecond{0};   // get_optimal_segment_parameter
+    long long score_table_nanosecond{0};        // comparison of tokens for the score tables
+    long long fill_nanosecond{0};               // filling the scoring matrices
+    long long traceback_nanosecond{0};          // backtracking the aligned paths
+    long long stitch_nanosecond{0};             // separating the references and putting the segments back together
+    long long exact_check_nanosecond{0};        // aligning with the exact engine to compare the score of the progressive engine
+    long long total_nanosecond{0};              // the whole align call
+    size_t segment_num{0};
+    size_t cell{0};                 // computed cells of the scoring matrices
+    size_t compare_call{0};         // distinct token pairs compared for the score tables
+    size_t edit_distance_call{0};   // edit distances computed for the comparisons
+    size_t peak_tensor_byte{0};     // largest scoring matrix (with traceback) allocated by a single alignment
+    size_t exact_check_segment{0};  // segments of the progressive engine also aligned with the exact engine
+    long long score_gap{0};         // optimal score minus the score of the progressive engine, added up over the checked segments
+    size_t band_limited_segment{0}; // segments aligned within a band narrower than the scoring matrix, whose result may be suboptimal
+    int band_width{0};              // widest final band width (over the speakers) of the band limited segments
+    std::vector<long long> segment_nanosecond;  // score table, fill and traceback time of each segment in order
+};
+
+class stage_timer {
+    /*
+     * Add the time from construction to destruction (or stop) to a stage of the stats, nothing is measured without stats
+     */
+public:
+    stage_timer(alignment_stats *, long long alignment_stats::*);
+
+    ~stage_timer();
+
+    stage_timer(const stage_timer&) = delete;
+
+    stage_timer& operator=(const stage_timer&) = delete;
+
+    long long stop();
+
+private:
+    alignment_stats *stats;
+    long long alignment_stats::*stage;
+    std::chrono::steady_clock::time_point start;
+};
+
+struct msa_config {
+    /*
+     * Options of the alignment engine, none of them changes the alignment result except banded alignment, which is a heuristic
+     * that can give a suboptimal result when the optimal path leaves the band without touching its edge (see band_limited_segment of the stats),
+     * the linear memory engine and the A* engine, which give a path with the same optimal score but may choose a different one
+     * among several optimal paths, and the progressive engine, which is approximate
+     */
+    int thread_num{1};  // number of threads to fill the scoring matrix or align segments, 0 or negative to use all hardware threads
+    size_t max_parallel_cell{(size_t)1 << 28};  // maximum total scoring matrix cells of segments aligned at the same time
+    int band_width{0};  // 0 to fill the whole scoring matrix, positive for banded alignment with fixed band width, or BAND_WIDTH_AUTO
+    bool store_traceback{false};  // store the winning move of each cell for faster backtracking, one more byte per cell
+    msa_engine engine{msa_engine::dense};  // engine of the alignment, band width is only used by the dense engine
+    size_t max_memory_bytes{0};  // memory budget of each alignment in bytes checked before allocation, 0 for no limit
+    alignment_stats *stats{nullptr};  // filled with the time of each stage and the counters of the alignment when set, nothing is printed
+};
+
+enum class token_match_type : uint8_t {
+    fully_match,
+    partially_match,
+    mismatch,
+    gap         // the hypothesis token or the reference token is a gap
+};
+
+struct alignment_cost {
+    /*
+     * Predicted cost of a multi-sequence alignment from get_alignment_cost
+     */
+    msa_engine engine{msa_engine::dense};  // engine of the alignment
+    int band_width{0};  // band width of the first pass of banded alignment, 0 if the whole scoring matrix is filled
+    size_t cell{0};     // number of computed cells of the scoring matrix
+    size_t byte{0};     // peak memory of the score table and the scoring matrix in bytes
+    double second{0};   // estimated running time in seconds
+};
+
+class memory_budget_error : public std::runtime_error {
+    /*
+     * Thrown before allocation when an alignment does not fit in max_memory_bytes of the config
+     */
+public:
+    using std::runtime_error::runtime_error;
+};
+
+struct neighbour_move {
+    /*
+     * Move from the current cell to a previous cell used for comparison in the scoring matrix,
+     * either a single token from one sequence or a hypothesis token together with a reference token
+     */
+    size_t offset;          // distance between the current cell and the previous cell in the one dimensional scoring matrix
+    int dimension;          // the sequence consuming a token, 0 for a hypothesis token alone
+    bool with_hypothesis;   // if the hypothesis consumes a token together with the reference sequence
+};
+
+inline int get_move_score(const neighbour_move& move, const std::vector<int>& current_index, const score_table& table) {
+    /*
+     * Get the score of a move from the score table, which is the same as the compare function on the consumed tokens
+     */
+    if (move.dimension == 0) {
+        return GAP_SCORE;
+    }
+    return table.get(move.dimension - 1, move.with_hypothesis ? current_index[0] - 1 : -1, current_index[move.dimension] - 1);
+}
+
+int edit_distance(std::string_view, std::string_view);
+
+bool bit_parallel_edit_distance_below(std::string_view, std::string_view, int);
+
+bool banded_edit_distance_below(std::string_view, std::string_view, int);
+
+bool edit_distance_below(std::string_view, std::string_view, int);
 
 int compare(const std::string &, const std::vector<std::string> &, int = 2);
 
@@ -28,6 +188,87 @@ std::vector<std::string> get_compare_parameter(const std::vector<int>&, const st
 
 size_t get_index(const std::vector<int>&, const std::vector<int>&);
 
-std::vector<std::vector<std::string>> multi_sequence_alignment(const std::vector<std::string>&, const std::vector<std::vector<std::string>>&, int = 2);
+class token_interner {
+    /*
+     * Map tokens to integer ids appended to a caller-owned vocabulary, equal tokens share the same id and GAP is always GAP_ID,
+     * the vocabulary keeps views of the interned tokens, so the tokens must outlive it
+     */
+public:
+    explicit token_interner(std::vector<std::string_view>&);
+
+    std::vector<uint32_t> intern(const std::vector<std::string>&);
+
+private:
+    std::vector<std::string_view>& vocabulary;
+    std::unordered_map<std::string_view, uint32_t> token_id;
+};
+
+std::vector<std::vector<uint32_t>> intern_token(const std::vector<std::string>&, const std::vector<std::vector<std::string>>&, std::vector<std::string_view>&);
+
+int compare(uint32_t, uint32_t, const std::vector<std::string_view>&, int = 2);
+
+score_table get_score_table(const std::vector<std::vector<uint32_t>>&, const std::vector<std::string_view>&, int = 2);
+
+int compare(uint32_t, uint32_t, const partial_match_function&);
+
+score_table get_score_table(const std::vector<std::vector<uint32_t>>&, const partial_match_function&);
+
+void add_alignment_stats(alignment_stats&, const alignment_stats&);
+
+void add_score_table_stats(alignment_stats *, const score_table&);
+
+int get_thread_num(int);
+
+std::vector<size_t> get_stride(const std::vector<int>&);
+
+std::vector<std::vector<neighbour_move>> get_neighbour_move_list(const std::vector<size_t>&);
+
+void fill_score(std::vector<int16_t>&, std::vector<uint8_t>&, const std::vector<int>&, const std::vector<size_t>&, const std::vector<std::vector<neighbour_move>>&, const score_table&);
+
+void fill_score_wavefront(std::vector<int16_t>&, std::vector<uint8_t>&, const std::vector<int>&, const std::vector<size_t>&, const std::vector<std::vector<neighbour_move>>&, const score_table&, int);
+
+std::vector<std::vector<int>> dense_alignment_index(const std::vector<std::vector<uint32_t>>&, const score_table&, const msa_config& = {});
+
+std::vector<int> get_band_width(const std::vector<size_t>&, int);
+
+std::pair<int, int> get_band_range(int, int, int, int);
+
+std::vector<std::vector<int>> banded_alignment_index(const std::vector<std::vector<uint32_t>>&, const score_table&, const std::vector<int>&, bool&, alignment_stats * = nullptr);
+
+std::vector<int> get_slice_score(const score_table&, int, int, const std::vector<int>&, const std::vector<int>&, bool);
+
+void linear_memory_alignment_aux(const std::vector<std::vector<uint32_t>>&, const score_table&, int, int, const std::vector<int>&, const std::vector<int>&, std::vector<std::vector<int>>&, alignment_stats *);
+
+std::vector<std::vector<int>> linear_memory_alignment_index(const std::vector<std::vector<uint32_t>>&, const score_table&, alignment_stats * = nullptr);
+
+std::vector<std::vector<int>> get_suffix_gain(const score_table&, int, int, int);
+
+std::vector<std::vector<int>> astar_alignment_index(const std::vector<std::vector<uint32_t>>&, const score_table&, size_t, bool&, alignment_stats * = nullptr);
+
+std::vector<int> pairwise_alignment_index(const score_table&, int, int, const std::vector<int>&, alignment_stats * = nullptr);
+
+std::vector<std::vector<int>> progressive_alignment_index(const std::vector<std::vector<uint32_t>>&, const score_table&, alignment_stats * = nullptr);
+
+int get_alignment_score(const std::vector<std::vector<int>>&, const score_table&);
+
+void check_exact_score(const std::vector<std::vector<uint32_t>>&, const score_table&, const std::vector<std::vector<int>>&, const msa_config&);
+
+std::vector<size_t> get_sequence_length(const std::vector<std::vector<uint32_t>>&);
+
+size_t get_banded_cell(const std::vector<size_t>&, const std::vector<int>&);
+
+size_t get_banded_byte(const std::vector<size_t>&, size_t);
+
+size_t get_astar_byte(const std::vector<size_t>&, size_t);
+
+alignment_cost get_alignment_cost(const std::vector<size_t>&, const msa_config& = {});
+
+msa_config plan_alignment(const std::vector<size_t>&, const msa_config&);
+
+std::vector<token_match_type> get_column_match(const std::vector<std::vector<int>>&, const score_table&);
+
+std::vector<std::vector<int>> multi_sequence_alignment_index(const std::vector<std::vector<uint32_t>>&, const score_table&, const msa_config& = {});
+
+std::vector<std::vector<std::string>> multi_sequence_alignment(const std::vector<std::string>&, const std::vector<std::vector<std::string>>&, int = 2, const msa_config& = {});
 
 #endif //MSA_MSA_H
@@ -1,25 +1,158 @@
+#include <cstdint>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include "msa.h"
 #include "postprocess.h"
 #include "preprocess.h"
 
-void write_csv(const std::string& file_name, const std::vector<std::vector<std::string>>& content) {
-    std::ofstream file;
-    file.open(file_name, std::ios::app);
-    if (file.is_open()) {
-        for (const auto& row: content) {
-            for (const auto& token: row) {
-                file << token << ",";
-            }
-            file << std::endl;
-        }
+result_writer::result_writer(const std::string& file_name, result_format format, bool append) : buffer(RESULT_WRITER_BUFFER_SIZE), format(format) {
+    /*
+     * Open the result file once with a large buffer
+     *
+     * @param file_name: path of the result file
+     * @param format: csv or binary
+     * @param append: append to an existing file (csv only, a binary file is always created anew)
+     */
+    file.rdbuf()->pubsetbuf(buffer.data(), (std::streamsize)buffer.size());
+    std::ios::openmode mode = std::ios::out;
+    if (format == result_format::binary) {
+        mode |= std::ios::binary | std::ios::trunc;
     } else {
+        mode |= append ? std::ios::app : std::ios::trunc;
+    }
+    file.open(file_name, mode);
+    if (!file.is_open()) {
         throw std::runtime_error("Could not open the file");
     }
+    if (format == result_format::binary) {
+        file.write(RESULT_BINARY_MAGIC, 4);
+        write_uint32(RESULT_BINARY_VERSION);
+    }
+}
+
+result_writer::~result_writer() {
+    if (file.is_open()) {
+        file.close();
+    }
+}
+
+void result_writer::close() {
+    /*
+     * Flush and close the file, throw if any write failed
+     */
     file.close();
+    if (file.fail()) {
+        throw std::runtime_error("Could not write the file");
+    }
+}
+
+void result_writer::write_uint32(size_t value) {
+    std::string byte;
+    append_uint32(byte, value);
+    file.write(byte.data(), 4);
+}
+
+void result_writer::write_result(const std::vector<std::vector<std::string>>& align_result, const std::vector<std::string>& token_match_result,
+                                 const std::vector<std::vector<int>>& align_indices, const std::vector<std::vector<int>>& ref_original_indices,
+                                 const std::vector<std::string>& unique_speaker_label, const std::vector<std::string>& aligned_hypo_speaker_label) {
+    /*
+     * Write all result tables of an alignment in one pass, in the order of
+     * alignment result, token match result, align indices, reference original indices, unique speaker labels
+     * and aligned hypothesis speaker labels
+     */
+    write_table(align_result);
+    write_row(token_match_result);
+    write_table(align_indices);
+    write_table(ref_original_indices);
+    write_row(unique_speaker_label);
+    write_row(aligned_hypo_speaker_label);
+}
+
+std::vector<result_table> read_result_binary(const std::string& file_name) {
+    /*
+     * Load all tables of a binary result file written by result_writer
+     *
+     * @param file_name: path of the result file
+     * @return: tables in the order they were written
+     */
+    std::ifstream file(file_name, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open the file");
+    }
+    file.seekg(0, std::ios::end);
+    std::string content((size_t)file.tellg(), '\0');
+    file.seekg(0, std::ios::beg);
+    file.read(content.data(), (std::streamsize)content.size());
+    size_t position{0};
+    auto read_uint32 = [&]() {
+        if (position + 4 > content.size()) {
+            throw std::runtime_error("Truncated result file");
+        }
+        uint32_t value{0};
+        for (int i = 0; i < 4; ++i) {
+            value |= (uint32_t)(unsigned char)content[position + i] << (8 * i);
+        }
+        position += 4;
+        return value;
+    };
+    auto read_count = [&]() {
+        // every row and every element takes at least 4 bytes, so a count beyond the rest of the file is never allocated
+        uint32_t count = read_uint32();
+        if ((size_t)count * 4 > content.size() - position) {
+            throw std::runtime_error("Truncated result file");
+        }
+        return count;
+    };
+    if (content.compare(0, 4, RESULT_BINARY_MAGIC) != 0) {
+        throw std::runtime_error("Not a result file");
+    }
+    position = 4;
+    if (read_uint32() != RESULT_BINARY_VERSION) {
+        throw std::runtime_error("Unsupported result file version");
+    }
+    std::vector<result_table> table;
+    while (position < content.size()) {
+        char type = content[position++];
+        if (type != 0 && type != 1) {
+            throw std::runtime_error("Unknown table type in result file");
+        }
+        uint32_t row_num = read_count();
+        if (type == 1) {
+            std::vector<std::vector<int>> int_table(row_num);
+            for (std::vector<int>& row: int_table) {
+                row.resize(read_count());
+                for (int& element: row) {
+                    element = (int)(int32_t)read_uint32();
+                }
+            }
+            table.emplace_back(std::move(int_table));
+        } else {
+            std::vector<std::vector<std::string>> string_table(row_num);
+            for (std::vector<std::string>& row: string_table) {
+                row.resize(read_count());
+                for (std::string& element: row) {
+                    uint32_t length = read_uint32();
+                    if (position + length > content.size()) {
+                        throw std::runtime_error("Truncated result file");
+                    }
+                    element.assign(content, position, length);
+                    position += length;
+                }
+            }
+            table.emplace_back(std::move(string_table));
+        }
+    }
+    return table;
+}
+
+void write_csv(const std::string& file_name, const std::vector<std::vector<std::string>>& content) {
+    result_writer(file_name).write_table(content);
 }
 
 std::vector<std::string> get_token_match_result(const std::vector<std::vector<std::string>>& final_result, int partial_bound) {
@@ -27,21 +160,40 @@ std::vector<std::string> get_token_match_result(const std::vector<std::vector<st
      * Get the match result (fully match, partially match, mismatch, gap) for each position of token after alignment
      * The rule of comparison must be the same as compare function in MSA
      *
+     * The tokens are interned and the score of each distinct pair of tokens is only calculated once,
+     * so repeated pairs in the alignment become table lookups.
+     *
      * @param final_result: final output of the alignment with just the aligned sequences from multi_sequence_alignment
      * @return: match result for each position of token specified in strings
      */
+    std::unordered_map<std::string_view, uint32_t> token_id;
+    std::unordered_map<uint64_t, int> pair_score;
+    auto get_token_id = [&](const std::string& token) {
+        return token_id.try_emplace(token, (uint32_t)token_id.size()).first->second;
+    };
     std::vector<std::string> token_match_result;
-    std::vector<std::string> compare_token;
+    token_match_result.reserve(final_result[0].size());
+    std::vector<const std::string*> compare_token;
     for (int i = 0; i < final_result[0].size(); ++i) {
         for (const std::vector<std::string>& sequence: final_result) {
             if (sequence[i] != GAP) {
-                compare_token.emplace_back(sequence[i]);
+                compare_token.emplace_back(&sequence[i]);
             }
         }
         if (compare_token.size() == 2) {
-            if (compare_token[0] == compare_token[1]) {
+            auto [it, inserted] = pair_score.try_emplace(((uint64_t)get_token_id(*compare_token[0]) << 32) | get_token_id(*compare_token[1]));
+            if (inserted) {
+                if (*compare_token[0] == *compare_token[1]) {
+                    it->second = FULLY_MATCH_SCORE;
+                } else if (edit_distance_below(*compare_token[0], *compare_token[1], partial_bound)) {
+                    it->second = PARTIAL_MATCH_SCORE;
+                } else {
+                    it->second = MISMATCH_SCORE;
+                }
+            }
+            if (it->second == FULLY_MATCH_SCORE) {
                 token_match_result.emplace_back("fully match");
-            } else if (edit_distance(compare_token[0], compare_token[1]) < partial_bound) {
+            } else if (it->second == PARTIAL_MATCH_SCORE) {
                 token_match_result.emplace_back("partially match");
             } else {
                 token_match_result.emplace_back("mismatch");
@@ -54,6 +206,54 @@ std::vector<std::string> get_token_match_result(const std::vector<std::vector<st
     return token_match_result;
 }
 
+std::string get_token_match_string(token_match_type match) {
+    switch (match) {
+        case token_match_type::fully_match:
+            return "fully match";
+        case token_match_type::partially_match:
+            return "partially match";
+        case token_match_type::mismatch:
+            return "mismatch";
+        default:
+            return "gap";
+    }
+}
+
+alignment_artifact get_alignment_artifact(const token_id_alignment& alignment, const std::vector<std::string>& hypo_speaker_label) {
+    /*
+     * Get all derived results of an alignment in a single pass over the aligned index, the match result is
+     * the one decided by the alignment and no token is compared or converted again.
+     *
+     * @param alignment: aligned index of align_token_index or align_token_id
+     * @param hypo_speaker_label: speaker label of each hypothesis token, empty to skip the aligned hypothesis speaker labels
+     * @return: token match result, align indices, reference original indices and aligned hypothesis speaker labels
+     */
+    const std::vector<int>& aligned_hypo = alignment.align_index[0];
+    alignment_artifact artifact;
+    artifact.token_match_result.reserve(aligned_hypo.size());
+    for (token_match_type match: alignment.column_match) {
+        artifact.token_match_result.emplace_back(get_token_match_string(match));
+    }
+    for (int i = 1; i < alignment.align_index.size(); ++i) {
+        std::vector<int> indexes, original_indexes;
+        for (int j = 0; j < aligned_hypo.size(); ++j) {
+            if (alignment.align_index[i][j] != -1) {
+                indexes.emplace_back(aligned_hypo[j] != -1 ? j : -1);
+                original_indexes.emplace_back(alignment.align_index[i][j]);
+            }
+        }
+        artifact.align_indices.emplace_back(std::move(indexes));
+        artifact.ref_original_indices.emplace_back(std::move(original_indexes));
+    }
+    if (!hypo_speaker_label.empty()) {
+        artifact.aligned_hypo_speaker_label.reserve(aligned_hypo.size());
+        for (int position: aligned_hypo) {
+            artifact.aligned_hypo_speaker_label.emplace_back(position != -1 ? hypo_speaker_label[position] : GAP);
+        }
+    }
+    return artifact;
+}
+
 std::vector<std::vector<int>> get_align_indices(const std::vector<std::vector<std::string>>& final_result) {
     /*
      * Get the indexes representing the mapping from each token in the separated reference sequences to the hypothesis.
@@ -80,10 +280,10 @@ std::vector<std::vector<int>> get_align_indices(const std::vector<std::vector<st
 }
 
 std::vector<std::vector<int>> get_ref_original_indices(const std::vector<std::string>& reference, const std::vector<std::string>&speaker_labels) {
-    std::vector<std::string> unique_speaker_labels = get_unique_speaker_label(speaker_labels);
-    std::vector<std::vector<int>> ref_original_indices(unique_speaker_labels.size());
+    speaker_label_index index = get_speaker_label_index(speaker_labels);
+    std::vector<std::vector<int>> ref_original_indices(index.unique_speaker_label.size());
     for (int i = 0; i < reference.size(); ++i) {
-        ref_original_indices[std::ranges::find(unique_speaker_labels, speaker_labels[i]) - unique_speaker_labels.begin()].emplace_back(i);
+        ref_original_indices[index.label_id[i]].emplace_back(i);
     }
     return ref_original_indices;
 }
@@ -2,52 +2,151 @@
 #define MSA_POSTPROCESS_H
 
 #include <algorithm>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <set>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
 #include <vector>
 
-template <typename T> void write_csv_single_line(const std::string& file_name, const T& row) {
+#include "align.h"
+#include "msa.h"
+
+struct alignment_artifact {
     /*
-     * Write single row of content to a new or existing csv file
+     * Derived results of an alignment from get_alignment_artifact, the same as the separate functions below would give
+     */
+    std::vector<std::string> token_match_result;          // same as get_token_match_result
+    std::vector<std::vector<int>> align_indices;          // same as get_align_indices
+    std::vector<std::vector<int>> ref_original_indices;   // same as get_ref_original_indices
+    std::vector<std::string> aligned_hypo_speaker_label;  // same as get_aligned_hypo_speaker_label, empty without hypothesis speaker labels
+};
+
+#define RESULT_BINARY_MAGIC "A4DR"
+#define RESULT_BINARY_VERSION 1
+#define RESULT_WRITER_BUFFER_SIZE (1 << 20)
+
+enum class result_format {
+    csv,    // each row is written as elements followed by a comma, same as write_csv
+    binary  // length-prefixed tables that can be loaded back by read_result_binary
+};
+
+// table of a binary result file, either strings (tokens, labels) or integers (indices)
+typedef std::variant<std::vector<std::vector<std::string>>, std::vector<std::vector<int>>> result_table;
+
+class result_writer {
+    /*
+     * Keep one buffered output file open and write every table of the alignment result to it,
+     * the file is only flushed when the writer is closed or destroyed.
      *
-     * @param file_name: path of the csv file
-     * @param row: content need to be written in csv, type has to be 1d structure that support range-based for loop
+     * The binary format starts with RESULT_BINARY_MAGIC and RESULT_BINARY_VERSION (uint32), then each table is
+     * a type byte (0 for strings, 1 for integers), the number of rows (uint32), and each row is the number of elements (uint32)
+     * followed by the elements, an integer is int32 and a string is its length (uint32) followed by its bytes,
+     * all integers are little-endian.
      */
-    std::ofstream file;
-    file.open(file_name, std::ios::app);
-    if (file.is_open()) {
+public:
+    explicit result_writer(const std::string&, result_format = result_format::csv, bool = true);
+
+    ~result_writer();
+
+    result_writer(const result_writer&) = delete;
+
+    result_writer& operator=(const result_writer&) = delete;
+
+    template <typename T> void write_row(const T& row) {
+        /*
+         * Write single row of content (a table with one row in binary format)
+         *
+         * @param row: content need to be written, type has to be 1d structure that support range-based for loop
+         */
+        begin_table<typename T::value_type>(1);
+        write_row_content(row);
+    }
+
+    template <typename T> void write_table(const T& content) {
+        /*
+         * Write multiple rows of content as one table
+         *
+         * @param content: content need to be written, type has to be 2d structure that support range-based for loop
+         */
+        begin_table<typename T::value_type::value_type>(content.size());
+        for (const auto& row: content) {
+            write_row_content(row);
+        }
+    }
+
+    void write_result(const std::vector<std::vector<std::string>>&, const std::vector<std::string>&, const std::vector<std::vector<int>>&,
+                      const std::vector<std::vector<int>>&, const std::vector<std::string>&, const std::vector<std::string>&);
+
+    void close();
+
+private:
+    template <typename E> void begin_table(size_t row_num) {
+        if (format == result_format::binary) {
+            file.put(std::is_arithmetic_v<E> ? 1 : 0);
+            write_uint32(row_num);
+        }
+    }
+
+    template <typename T> void write_row_content(const T& row) {
+        if (format == result_format::csv) {
+            for (const auto& element: row) {
+                file << element << ',';
+            }
+            file << '\n';
+            return;
+        }
+        // the row is serialized first so that the stream is written once per row
+        row_byte.clear();
+        append_uint32(row_byte, std::size(row));
         for (const auto& element: row) {
-            file << element << ",";
+            if constexpr (std::is_arithmetic_v<std::decay_t<decltype(element)>>) {
+                append_uint32(row_byte, (uint32_t)(int32_t)element);
+            } else {
+                std::string_view token(element);
+                append_uint32(row_byte, token.size());
+                row_byte.append(token);
+            }
+        }
+        file.write(row_byte.data(), (std::streamsize)row_byte.size());
+    }
+
+    static void append_uint32(std::string& byte, size_t value) {
+        for (int i = 0; i < 4; ++i) {
+            byte += (char)((value >> (8 * i)) & 0xFF);
         }
-        file << std::endl;
-    } else {
-        throw std::runtime_error("Could not open the file");
     }
-    file.close();
+
+    void write_uint32(size_t);
+
+    std::ofstream file;
+    std::vector<char> buffer;
+    std::string row_byte;
+    result_format format;
+};
+
+template <typename T> void write_csv_single_line(const std::string& file_name, const T& row) {
+    /*
+     * Write single row of content to a new or existing csv file, use result_writer to write many rows to the same file
+     *
+     * @param file_name: path of the csv file
+     * @param row: content need to be written in csv, type has to be 1d structure that support range-based for loop
+     */
+    result_writer(file_name).write_row(row);
 }
 
 template <typename T> void write_csv_multiple_line(const std::string& file_name, const T& content) {
     /*
-     * Write multiple rows of content to a new or existing csv file
+     * Write multiple rows of content to a new or existing csv file, use result_writer to write many tables to the same file
      *
      * @param file_name: path of the csv file
      * @param row: content need to be written in csv, type has to be 2d structure that support range-based for loop
      */
-    std::ofstream file;
-    file.open(file_name, std::ios::app);
-    if (file.is_open()) {
-        for (const auto& row: content) {
-            for (const auto& element: row) {
-                file << element << ",";
-            }
-            file << std::endl;
-        }
-    } else {
-        throw std::runtime_error("Could not open the file");
-    }
-    file.close();
+    result_writer(file_name).write_table(content);
 }
 
 void write_csv(const std::string&, const std::vector<std::vector<std::string>>&);
@@ -60,4 +159,10 @@ std::vector<std::vector<int>> get_ref_original_indices(const std::vector<std::st
 
 std::vector<std::string> get_aligned_hypo_speaker_label(const std::vector<std::vector<std::string>>&, const std::vector<std::string>&);
 
+std::string get_token_match_string(token_match_type);
+
+alignment_artifact get_alignment_artifact(const token_id_alignment&, const std::vector<std::string>& = {});
+
+std::vector<result_table> read_result_binary(const std::string&);
+
 #endif //MSA_POSTPROCESS_H
@@ -1,12 +1,193 @@
 #include <algorithm>
 #include <iostream>
 #include <climits>
-#include <set>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <span>
 #include <string>
+#include <string_view>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "preprocess.h"
+#include "thread_pool.h"
+
+csv_file::csv_file(const std::string& file_name) {
+    /*
+     * Map the csv file into memory and index the start of each row, a line break inside a quoted field
+     * does not start a new row, which is detected by the parity of the double quotes before it in the row
+     *
+     * @param file_name: file name as string
+     */
+#ifdef _WIN32
+    HANDLE file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER file_size;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &file_size)) {
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+        }
+        throw std::runtime_error("Could not open the file");
+    }
+    file_handle = file;
+    size = (size_t)file_size.QuadPart;
+    if (size > 0) {
+        mapping_handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        data = mapping_handle ? (const char *)MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!data) {
+            if (mapping_handle) {
+                CloseHandle(mapping_handle);
+            }
+            CloseHandle(file);
+            throw std::runtime_error("Could not map the file");
+        }
+    }
+#else
+    int file = open(file_name.c_str(), O_RDONLY);
+    struct stat file_stat{};
+    if (file < 0 || fstat(file, &file_stat) != 0) {
+        if (file >= 0) {
+            close(file);
+        }
+        throw std::runtime_error("Could not open the file");
+    }
+    size = (size_t)file_stat.st_size;
+    if (size > 0) {
+        void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (mapping == MAP_FAILED) {
+            close(file);
+            throw std::runtime_error("Could not map the file");
+        }
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        data = (const char *)mapping;
+    }
+    close(file);
+#endif
+
+    size_t position{0};
+    while (position < size) {
+        row_start.emplace_back(position);
+        size_t quote_num{0};
+        while (true) {
+            const char *line_end = (const char *)memchr(data + position, '\n', size - position);
+            size_t end = line_end ? line_end - data : size;
+            quote_num += std::count(data + position, data + end, '"');
+            position = end + 1;
+            if (quote_num % 2 == 0 || position >= size) {
+                break;
+            }
+        }
+    }
+    row_start.emplace_back(std::max(position, size));
+}
+
+csv_file::~csv_file() {
+#ifdef _WIN32
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+    if (mapping_handle) {
+        CloseHandle(mapping_handle);
+    }
+    if (file_handle) {
+        CloseHandle(file_handle);
+    }
+#else
+    if (data) {
+        munmap((void *)data, size);
+    }
+#endif
+    data = nullptr;
+    mapping_handle = file_handle = nullptr;
+}
+
+size_t csv_file::row_num() const {
+    return row_start.size() - 1;
+}
+
+std::vector<std::string_view> csv_file::get_field_view(size_t row) const {
+    /*
+     * Split a row into fields without copying, the view of a quoted field excludes the surrounding double quotes
+     * but still contains the escaped double quotes (""), which are removed by get_csv_field.
+     * Same as splitting the line by comma, an empty row has no field and a trailing comma does not add an empty field.
+     *
+     * @param row: index of the row
+     * @return: fields of the row as views into the mapped file
+     */
+    if (row >= row_num()) {
+        throw std::out_of_range("row " + std::to_string(row) + " is out of range of the csv file with " + std::to_string(row_num()) + " rows");
+    }
+    size_t begin = row_start[row];
+    size_t end = std::min(row_start[row + 1], size);
+    if (end > begin && data[end - 1] == '\n') {
+        --end;
+    }
+    if (end > begin && data[end - 1] == '\r') {
+        --end;
+    }
+    std::vector<std::string_view> field;
+    size_t position = begin;
+    while (position < end) {
+        if (data[position] == '"') {
+            // quoted field ends at a double quote that is not followed by another one
+            size_t field_begin = position + 1;
+            size_t field_end = field_begin;
+            while (field_end < end && !(data[field_end] == '"' && (field_end + 1 >= end || data[field_end + 1] != '"'))) {
+                field_end += data[field_end] == '"' ? 2 : 1;
+            }
+            field.emplace_back(data + field_begin, std::min(field_end, end) - field_begin);
+            const char *comma = (const char *)memchr(data + std::min(field_end, end), ',', end - std::min(field_end, end));
+            position = comma ? comma - data + 1 : end;
+        } else {
+            const char *comma = (const char *)memchr(data + position, ',', end - position);
+            size_t field_end = comma ? comma - data : end;
+            field.emplace_back(data + position, field_end - position);
+            position = field_end + 1;
+        }
+    }
+    return field;
+}
+
+std::vector<std::string> csv_file::get_row(size_t row) const {
+    /*
+     * Get the fields of a row as strings with the escaped double quotes removed
+     */
+    std::vector<std::string_view> field = get_field_view(row);
+    std::vector<std::string> content;
+    content.reserve(field.size());
+    for (std::string_view view: field) {
+        content.emplace_back(get_csv_field(view));
+    }
+    return content;
+}
+
+std::string get_csv_field(std::string_view field) {
+    /*
+     * Remove the escaping of double quotes ("" to ") in a field from csv_file::get_field_view
+     */
+    std::string content;
+    content.reserve(field.size());
+    for (size_t i = 0; i < field.size(); ++i) {
+        content += field[i];
+        if (field[i] == '"' && i + 1 < field.size() && field[i + 1] == '"') {
+            ++i;
+        }
+    }
+    return content;
+}
 
 std::vector<std::vector<std::string>> read_csv(const std::string& file_name) {
     /*
@@ -15,23 +196,12 @@ std::vector<std::vector<std::string>> read_csv(const std::string& file_name) {
      * @param file_name: file name as string
      * @return: 2d vector of strings, each vector of strings represent a row of csv file, each string is the content separated by comma
      */
+    csv_file file(file_name);
     std::vector<std::vector<std::string>> content;
-    std::vector<std::string> row;
-    std::string line, word;
-
-    std::fstream file(file_name);
-    if (file.is_open()) {
-        while (getline(file, line)) {
-            row.clear();
-            std::stringstream str(line);
-            while (getline(str, word, ','))
-                row.emplace_back(word);
-            content.emplace_back(row);
-        }
-    } else {
-        throw std::runtime_error("Could not open the file");
+    content.reserve(file.row_num());
+    for (size_t i = 0; i < file.row_num(); ++i) {
+        content.emplace_back(file.get_row(i));
     }
-    file.close();
     return content;
 }
 
@@ -61,16 +231,182 @@ std::vector<std::vector<std::string>> get_total_reference_with_label(const std::
 
 std::vector<std::string> get_unique_speaker_label(const std::vector<std::string>& speaker_labels) {
     /*
-     * Generate vector of unique speaker labels by using set to remove duplicates
+     * Generate vector of unique speaker labels in sorted order
      *
      * The actual implementation needs to be stable that giving the exact same output for the same input
      *
      * @param speaker_labels: sequence of speaker labels in vector of strings
      * @return: unique sequence of speaker labels
      */
-    std::set<std::string> unique_speaker_label_set(speaker_labels.begin(), speaker_labels.end());
-    std::vector<std::string> unique_speaker_labels(unique_speaker_label_set.begin(), unique_speaker_label_set.end());
-    return unique_speaker_labels;
+    return get_speaker_label_index(speaker_labels).unique_speaker_label;
+}
+
+speaker_label_index get_speaker_label_index(const std::vector<std::string>& speaker_labels) {
+    return get_speaker_label_index(std::span<const std::string>(speaker_labels));
+}
+
+std::vector<uint32_t> get_segment_speaker(std::span<const uint32_t> label_id, std::vector<int>& speaker_row) {
+    /*
+     * Get the speakers of a segment in ascending order of dense speaker id and set the row of each of them in speaker_row,
+     * the cost is linear in the segment instead of the total number of speakers
+     *
+     * @param label_id: dense speaker id of each reference token of the segment
+     * @param speaker_row: -1 for every speaker, the rows of the speakers in the segment are set (0 for the first one),
+     * the caller sets them back to -1 after the segment
+     * @return: speaker ids in the segment in ascending order
+     */
+    std::vector<uint32_t> segment_speaker;
+    for (uint32_t id: label_id) {
+        if (speaker_row[id] == -1) {
+            speaker_row[id] = 0;
+            segment_speaker.emplace_back(id);
+        }
+    }
+    std::ranges::sort(segment_speaker);
+    for (int i = 0; i < segment_speaker.size(); ++i) {
+        speaker_row[segment_speaker[i]] = i;
+    }
+    return segment_speaker;
+}
+
+barrier_table get_barrier_table(const std::vector<std::string>& hypothesis, const std::vector<std::string>& reference, int barrier_length) {
+    /*
+     * Index every barrier (sequence of barrier_length tokens) of the reference once, so that the occurrences of
+     * the barrier starting at each hypothesis position are found without comparing it with every reference position.
+     *
+     * The tokens are interned to integer ids and the barriers are indexed on the ids, see below.
+     * Same as the scanning segmentation, the barriers start before hypothesis.size() - barrier_length
+     * and reference.size() - barrier_length (exclusive).
+     *
+     * @param hypothesis: hypothesis token sequence as vector of string
+     * @param reference: reference token sequence as vector of string
+     * @param barrier_length: length of sequence that is used to determine the absolute correct point to chop the segment
+     * @return: barrier id of each hypothesis position and sorted reference positions of each barrier
+     */
+    // intern tokens, hypothesis tokens not in reference can not be part of any barrier
+    std::unordered_map<std::string_view, uint32_t> token_id;
+    std::vector<uint32_t> reference_id, hypothesis_id;
+    for (const std::string& token: reference) {
+        reference_id.emplace_back(token_id.try_emplace(token, (uint32_t)token_id.size()).first->second);
+    }
+    for (const std::string& token: hypothesis) {
+        auto it = token_id.find(token);
+        hypothesis_id.emplace_back(it != token_id.end() ? it->second : UINT32_MAX);
+    }
+    return get_barrier_table(std::span<const uint32_t>(hypothesis_id), std::span<const uint32_t>(reference_id), barrier_length);
+}
+
+barrier_table get_barrier_table(std::span<const uint32_t> hypothesis_id, std::span<const uint32_t> reference_id, int barrier_length) {
+    /*
+     * Index every barrier of the reference on token ids, each barrier is hashed with a rolling hash,
+     * barriers with the same hash are compared token by token so that every distinct barrier gets its own id.
+     *
+     * @param hypothesis_id: hypothesis token ids, UINT32_MAX for a token known not to be in reference
+     * @param reference_id: reference token ids
+     * @param barrier_length: length of sequence that is used to determine the absolute correct point to chop the segment
+     * @return: barrier id of each hypothesis position and sorted reference positions of each barrier
+     */
+    barrier_table table;
+    table.barrier_length = barrier_length;
+    table.hypothesis_length = (int)hypothesis_id.size();
+    table.reference_length = (int)reference_id.size();
+    int hypothesis_barrier_num = std::max(0, (int)hypothesis_id.size() - barrier_length);
+    int reference_barrier_num = std::max(0, (int)reference_id.size() - barrier_length);
+    table.hypothesis_barrier.assign(hypothesis_barrier_num, -1);
+    if (reference_barrier_num == 0 || barrier_length < 0) {
+        return table;
+    }
+
+    // rolling hash of the barrier starting at each position
+    uint64_t leading_power{1};
+    for (int k = 1; k < barrier_length; ++k) {
+        leading_power *= BARRIER_HASH_BASE;
+    }
+    auto for_each_barrier_hash = [&](std::span<const uint32_t> id, int barrier_num, auto&& visit) {
+        uint64_t hash{0};
+        for (int k = 0; k < barrier_length && k < id.size(); ++k) {
+            hash = hash * BARRIER_HASH_BASE + id[k];
+        }
+        for (int j = 0; j < barrier_num; ++j) {
+            visit(j, hash);
+            if (barrier_length > 0 && j + barrier_length < id.size()) {
+                hash = (hash - id[j] * leading_power) * BARRIER_HASH_BASE + id[j + barrier_length];
+            }
+        }
+    };
+    auto is_same_barrier = [&](std::span<const uint32_t> id, int position, int barrier) {
+        int barrier_position = table.barrier_position[barrier].front();
+        return std::equal(id.begin() + position, id.begin() + position + barrier_length, reference_id.begin() + barrier_position);
+    };
+    std::unordered_map<uint64_t, std::vector<int>> hash_barrier;
+    for_each_barrier_hash(reference_id, reference_barrier_num, [&](int j, uint64_t hash) {
+        std::vector<int>& candidate = hash_barrier[hash];
+        auto it = std::ranges::find_if(candidate, [&](int barrier) { return is_same_barrier(reference_id, j, barrier); });
+        if (it != candidate.end()) {
+            table.barrier_position[*it].emplace_back(j);
+        } else {
+            candidate.emplace_back((int)table.barrier_position.size());
+            table.barrier_position.push_back({j});
+        }
+    });
+
+    // barrier id of each hypothesis position, skipping the windows with tokens not in reference
+    int last_unknown{-1};
+    for (int i = 0; i < barrier_length - 1 && i < hypothesis_id.size(); ++i) {
+        if (hypothesis_id[i] == UINT32_MAX) {
+            last_unknown = i;
+        }
+    }
+    for_each_barrier_hash(hypothesis_id, hypothesis_barrier_num, [&](int i, uint64_t hash) {
+        if (barrier_length > 0 && hypothesis_id[i + barrier_length - 1] == UINT32_MAX) {
+            last_unknown = i + barrier_length - 1;
+        }
+        if (last_unknown >= i) {
+            return;
+        }
+        auto it = hash_barrier.find(hash);
+        if (it == hash_barrier.end()) {
+            return;
+        }
+        for (int barrier: it->second) {
+            if (is_same_barrier(hypothesis_id, i, barrier)) {
+                table.hypothesis_barrier[i] = barrier;
+                break;
+            }
+        }
+    });
+    return table;
+}
+
+std::vector<std::vector<int>> get_segment_index(const barrier_table& table, int segment_length) {
+    /*
+     * Segment the hypothesis and reference text with the barriers indexed by get_barrier_table,
+     * the result is the same as get_segment_index on the text, see below.
+     * For each hypothesis position, the first occurrence of its barrier at or after the last reference segmentation point
+     * is found by a binary search on the sorted reference positions of the barrier.
+     *
+     * @param table: barrier table from get_barrier_table
+     * @param segment_length: length of each segment (around this value, mostly will be equal or greater) based on hypothesis segment
+     * @return: same as get_segment_index on the text
+     */
+    std::vector<int> hypo_index{0}, ref_index{0};
+    for (int i = segment_length; i < table.hypothesis_barrier.size(); ++i) {
+        int barrier = table.hypothesis_barrier[i];
+        if (barrier == -1) {
+            continue;
+        }
+        const std::vector<int>& position = table.barrier_position[barrier];
+        auto it = std::ranges::lower_bound(position, ref_index.back());
+        if (it != position.end()) {
+            hypo_index.emplace_back(i + (int)(table.barrier_length / 2));
+            ref_index.emplace_back(*it + (int)(table.barrier_length / 2));
+            i += segment_length;
+        }
+    }
+    hypo_index.emplace_back(table.hypothesis_length);
+    ref_index.emplace_back(table.reference_length);
+    std::vector<std::vector<int>> segment_index{hypo_index, ref_index};
+    return segment_index;
 }
 
 std::vector<std::vector<int>> get_segment_index(const std::vector<std::string>& hypothesis, const std::vector<std::string>& reference, int segment_length, int barrier_length) {
@@ -81,7 +417,8 @@ std::vector<std::vector<int>> get_segment_index(const std::vector<std::string>&
      * then it compare the next sequence with length of barrier_length with every possible sequence with length of barrier_length within reference;
      * if two sequence are equal, the index for segmentation is the midpoint of these two barrier_length sequence,
      * then it advance the length of segment_length and continue segmentation with the above procedure;
-     * if no equal sequence are found in reference, the hypothesis index will only advance by 1 and continue above procedure
+     * if no equal sequence are found in reference, the hypothesis index will only advance by 1 and continue above procedure,
+     * the barriers of reference are indexed once by get_barrier_table instead of comparing with every reference position
      *
      * @param hypothesis: hypothesis token sequence as vector of string
      * @param reference: reference token sequence as vector of string
@@ -92,26 +429,7 @@ std::vector<std::vector<int>> get_segment_index(const std::vector<std::string>&
      * @return: 2d vector of int, including 2 vector of int, the first one is the index of segmentation of hypothesis,
      * the second one is for reference, including first and last index of the whole text
      */
-    std::vector<int> hypo_index{0}, ref_index{0};
-    bool is_same_sequence;
-    for (int i = segment_length; i < hypothesis.size() - barrier_length; ++i) {
-        for (int j = ref_index.back(); j < reference.size() - barrier_length; ++j) {
-//            if (j - ref_index.back() > 5 * segment_length) {
-//                break;
-//            }
-            is_same_sequence = std::equal(hypothesis.begin() + i, hypothesis.begin() + i + barrier_length, reference.begin() + j);
-            if (is_same_sequence) {
-                hypo_index.emplace_back(i + (int)(barrier_length / 2));
-                ref_index.emplace_back(j + (int)(barrier_length / 2));
-                i += segment_length;
-                break;
-            }
-        }
-    }
-    hypo_index.emplace_back(hypothesis.size());
-    ref_index.emplace_back(reference.size());
-    std::vector<std::vector<int>> segment_index{hypo_index, ref_index};
-    return segment_index;
+    return get_segment_index(get_barrier_table(hypothesis, reference, barrier_length), segment_length);
 }
 
 std::vector<std::vector<std::string>> get_segment_sequence(const std::vector<std::string>& tokens, const std::vector<int>& segment_index) {
@@ -130,10 +448,10 @@ std::vector<std::vector<std::string>> get_segment_sequence(const std::vector<std
 }
 
 std::vector<std::vector<std::string>> get_separate_sequence(const std::vector<std::string>& tokens, const std::vector<std::string>& speaker_labels) {
-    std::vector<std::string> unique_speaker_labels = get_unique_speaker_label(speaker_labels);
-    std::vector<std::vector<std::string>> reference(unique_speaker_labels.size());
+    speaker_label_index index = get_speaker_label_index(speaker_labels);
+    std::vector<std::vector<std::string>> reference(index.unique_speaker_label.size());
     for (int i = 0; i < tokens.size(); ++i) {
-        reference[std::ranges::find(unique_speaker_labels, speaker_labels[i]) - unique_speaker_labels.begin()].emplace_back(tokens[i]);
+        reference[index.label_id[i]].emplace_back(tokens[i]);
     }
     return reference;
 }
@@ -147,20 +465,21 @@ std::vector<std::vector<std::string>> get_separate_sequence_with_label(const std
      * @return: 2d vector of strings, if there are n speakers in total, the output will be n+1 vectors,
      * the front n sequences are separated tokens for each sequence, the last one is the vector of unique speaker labels in the input
      */
-    std::vector<std::string> unique_speaker_labels = get_unique_speaker_label(speaker_labels);
-    std::vector<std::vector<std::string>> reference(unique_speaker_labels.size());
+    speaker_label_index index = get_speaker_label_index(speaker_labels);
+    std::vector<std::vector<std::string>> reference(index.unique_speaker_label.size());
     for (int i = 0; i < tokens.size(); ++i) {
-        reference[std::ranges::find(unique_speaker_labels, speaker_labels[i]) - unique_speaker_labels.begin()].emplace_back(tokens[i]);
+        reference[index.label_id[i]].emplace_back(tokens[i]);
     }
-    reference.emplace_back(unique_speaker_labels);
+    reference.emplace_back(std::move(index.unique_speaker_label));
     return reference;
 }
 
 void test_segment_parameter(int min_length, int max_length, int barrier_length, const std::vector<std::string>& hypothesis, const std::vector<std::string>& reference) {
     std::cout << "min segment length: " << min_length << " max segment length: " << max_length << " barrier length: " << barrier_length << std::endl;
+    barrier_table table = get_barrier_table(hypothesis, reference, barrier_length);
     std::vector<std::vector<int>> segment_index;
     for (int i = min_length; i < max_length; ++i) {
-        segment_index = get_segment_index(hypothesis, reference, i, barrier_length);
+        segment_index = get_segment_index(table, i);
         int hypo_max{0}, ref_max{0};
         for (int j = 0; j < segment_index[0].size() - 1; ++j) {
             int hypo_index_diff = segment_index[0][j + 1] - segment_index[0][j];
@@ -176,26 +495,71 @@ void test_segment_parameter(int min_length, int max_length, int barrier_length,
     }
 }
 
-std::tuple<int, int> get_optimal_segment_parameter(const std::vector<std::string>& hypothesis, const std::vector<std::string>& reference, int min_length, int max_length, int barrier_length) {
-    std::vector<std::vector<int>> segment_index;
-    int optimal_length{0}, hypo_ref_min_sum{INT_MAX};
-    for (int i = min_length; i < max_length; ++i) {
-        segment_index = get_segment_index(hypothesis, reference, i, barrier_length);
-        int hypo_max{0}, ref_max{0};
-        for (int j = 0; j < segment_index[0].size() - 1; ++j) {
-            int hypo_index_diff = segment_index[0][j + 1] - segment_index[0][j];
-            int ref_index_diff = segment_index[1][j + 1] - segment_index[1][j];
-            if (hypo_index_diff > hypo_max) {
-                hypo_max = hypo_index_diff;
-            }
-            if (ref_index_diff > ref_max) {
-                ref_max = ref_index_diff;
-            }
+int get_max_segment_length_sum(const std::vector<std::vector<int>>& segment_index) {
+    /*
+     * Get the sum of the maximum hypothesis segment length and the maximum reference segment length
+     */
+    int hypo_max{0}, ref_max{0};
+    for (int j = 0; j < segment_index[0].size() - 1; ++j) {
+        int hypo_index_diff = segment_index[0][j + 1] - segment_index[0][j];
+        int ref_index_diff = segment_index[1][j + 1] - segment_index[1][j];
+        if (hypo_index_diff > hypo_max) {
+            hypo_max = hypo_index_diff;
         }
-//        std::cout << "segment length: " << i << " max hypothesis length: " << hypo_max << " max reference length: " << ref_max << std::endl;
-        if (hypo_max + ref_max <= hypo_ref_min_sum) {
-            optimal_length = i;
-            hypo_ref_min_sum = hypo_max + ref_max;
+        if (ref_index_diff > ref_max) {
+            ref_max = ref_index_diff;
+        }
+    }
+    return hypo_max + ref_max;
+}
+
+std::tuple<int, int> get_optimal_segment_parameter(const std::vector<std::string>& hypothesis, const std::vector<std::string>& reference, int min_length, int max_length, int barrier_length, int thread_num) {
+    /*
+     * Search the segment length between min_length and max_length (exclusive) with the smallest sum of
+     * the maximum hypothesis segment length and the maximum reference segment length, the larger segment length wins a tie.
+     *
+     * The barriers are indexed once and shared by all candidate segment lengths, so each candidate only repeats
+     * the cheap selection of segmentation points, the candidates are evaluated in parallel with more than 1 thread.
+     *
+     * @param min_length: smallest candidate segment length
+     * @param max_length: largest candidate segment length (exclusive)
+     * @param barrier_length: length of sequence that is used to determine the absolute correct point to chop the segment
+     * @param thread_num: number of threads to evaluate the candidates
+     * @return: optimal segment length and barrier length
+     */
+    return get_optimal_segment_parameter(get_barrier_table(hypothesis, reference, barrier_length), min_length, max_length, thread_num);
+}
+
+std::tuple<int, int> get_optimal_segment_parameter(const barrier_table& table, int min_length, int max_length, int thread_num) {
+    /*
+     * Search the optimal segment length with the barriers already indexed by get_barrier_table, see above
+     *
+     * @return: optimal segment length and barrier length of the table
+     */
+    int barrier_length = table.barrier_length;
+    int candidate_num = std::max(0, max_length - min_length);
+    std::vector<int> length_sum(candidate_num);
+    auto evaluate_candidate = [&](int k) {
+        length_sum[k] = get_max_segment_length_sum(get_segment_index(table, min_length + k));
+    };
+    if (thread_num <= 1 || candidate_num <= 1) {
+        for (int k = 0; k < candidate_num; ++k) {
+            evaluate_candidate(k);
+        }
+    } else {
+        thread_pool pool(std::min(thread_num, candidate_num));
+        for (int k = 0; k < candidate_num; ++k) {
+            pool.submit([&, k]() { evaluate_candidate(k); });
+        }
+        pool.wait();
+    }
+
+    int optimal_length{0}, hypo_ref_min_sum{INT_MAX};
+    for (int k = 0; k < candidate_num; ++k) {
+//        std::cout << "segment length: " << min_length + k << " max hypothesis and reference length: " << length_sum[k] << std::endl;
+        if (length_sum[k] <= hypo_ref_min_sum) {
+            optimal_length = min_length + k;
+            hypo_ref_min_sum = length_sum[k];
         }
     }
 //    std::cout << "optimal length: " << optimal_length << " optimal barrier length: " << barrier_length << std::endl;
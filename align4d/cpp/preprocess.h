@@ -1,13 +1,77 @@
 #ifndef MSA_PROCESSTEXT_H
 #define MSA_PROCESSTEXT_H
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <fstream>
+#include <numeric>
+#include <span>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <tuple>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
+#define BARRIER_HASH_BASE 1000003ULL
+#define AUTO_SEGMENT_MIN_LENGTH 30
+#define AUTO_SEGMENT_MAX_LENGTH 120
+#define AUTO_SEGMENT_BARRIER_LENGTH 6
+
+struct barrier_table {
+    /*
+     * Occurrences of the barriers (sequences of barrier_length tokens) shared by hypothesis and reference from get_barrier_table
+     */
+    int barrier_length{0};
+    int hypothesis_length{0};
+    int reference_length{0};
+    std::vector<int> hypothesis_barrier;                // barrier id starting at each hypothesis position, -1 if it is not in reference
+    std::vector<std::vector<int>> barrier_position;     // sorted reference positions of each barrier
+};
+
+template <typename label_type>
+struct basic_speaker_label_index {
+    /*
+     * Dense ids of the speaker labels from get_speaker_label_index, the ids follow the sorted order of the labels
+     */
+    std::vector<label_type> unique_speaker_label;
+    std::vector<uint32_t> label_id;     // id of each input label, which is its index in unique_speaker_label
+};
+
+typedef basic_speaker_label_index<std::string> speaker_label_index;
+
+class csv_file {
+    /*
+     * Memory-mapped csv file, the rows are indexed once when the file is opened and the fields of a row
+     * are only split when the row is requested, quoted fields may contain commas, double quotes ("") and line breaks
+     */
+public:
+    explicit csv_file(const std::string&);
+
+    ~csv_file();
+
+    csv_file(const csv_file&) = delete;
+
+    csv_file& operator=(const csv_file&) = delete;
+
+    size_t row_num() const;
+
+    std::vector<std::string_view> get_field_view(size_t) const;
+
+    std::vector<std::string> get_row(size_t) const;
+
+private:
+    const char *data{nullptr};
+    size_t size{0};
+    void *file_handle{nullptr};     // handles of the mapping on Windows
+    void *mapping_handle{nullptr};
+    std::vector<size_t> row_start;  // offset of each row and the end of the file
+};
+
+std::string get_csv_field(std::string_view);
+
 std::vector<std::vector<std::string>> read_csv(const std::string&);
 
 std::vector<std::string> get_total_hypothesis(const std::vector<std::vector<std::string>>&, int);
@@ -16,6 +80,52 @@ std::vector<std::vector<std::string>> get_total_reference_with_label(const std::
 
 std::vector<std::string> get_unique_speaker_label(const std::vector<std::string>&);
 
+template <typename label_type>
+basic_speaker_label_index<label_type> get_speaker_label_index(std::span<const label_type> speaker_labels) {
+    /*
+     * Map every speaker label to a dense id in one pass with a hash map, then renumber the ids by the sorted order of the labels,
+     * so that the unique speaker labels are the same as a set of the labels and a label is found by its id instead of searching
+     *
+     * @param speaker_labels: sequence of speaker labels, strings are hashed by view without copying
+     * @return: unique speaker labels in sorted order and the id of each label
+     */
+    typedef std::conditional_t<std::is_same_v<label_type, std::string>, std::string_view, label_type> key_type;
+    basic_speaker_label_index<label_type> index;
+    std::unordered_map<key_type, uint32_t> first_id;
+    std::vector<key_type> first_label;
+    index.label_id.reserve(speaker_labels.size());
+    for (const label_type& label: speaker_labels) {
+        auto [it, inserted] = first_id.try_emplace(label, (uint32_t)first_label.size());
+        if (inserted) {
+            first_label.emplace_back(label);
+        }
+        index.label_id.emplace_back(it->second);
+    }
+    std::vector<uint32_t> order(first_label.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::sort(order, [&](uint32_t a, uint32_t b) { return first_label[a] < first_label[b]; });
+    std::vector<uint32_t> rank(order.size());
+    index.unique_speaker_label.reserve(order.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        rank[order[i]] = i;
+        index.unique_speaker_label.emplace_back(first_label[order[i]]);
+    }
+    for (uint32_t& id: index.label_id) {
+        id = rank[id];
+    }
+    return index;
+}
+
+speaker_label_index get_speaker_label_index(const std::vector<std::string>&);
+
+std::vector<uint32_t> get_segment_speaker(std::span<const uint32_t>, std::vector<int>&);
+
+barrier_table get_barrier_table(const std::vector<std::string>&, const std::vector<std::string>&, int);
+
+barrier_table get_barrier_table(std::span<const uint32_t>, std::span<const uint32_t>, int);
+
+std::vector<std::vector<int>> get_segment_index(const barrier_table&, int);
+
 std::vector<std::vector<int>> get_segment_index(const std::vector<std::string>&, const std::vector<std::string>&, int, int);
 
 std::vector<std::vector<std::string>> get_segment_sequence(const std::vector<std::string>&, const std::vector<int>&);
@@ -26,6 +136,10 @@ std::vector<std::vector<std::string>> get_separate_sequence_with_label(const std
 
 void test_segment_parameter(int, int, int, const std::vector<std::string>&, const std::vector<std::string>&);
 
-std::tuple<int, int> get_optimal_segment_parameter(const std::vector<std::string>&, const std::vector<std::string>&, int = 30, int = 120, int = 6);
+int get_max_segment_length_sum(const std::vector<std::vector<int>>&);
+
+std::tuple<int, int> get_optimal_segment_parameter(const std::vector<std::string>&, const std::vector<std::string>&, int = AUTO_SEGMENT_MIN_LENGTH, int = AUTO_SEGMENT_MAX_LENGTH, int = AUTO_SEGMENT_BARRIER_LENGTH, int = 1);
+
+std::tuple<int, int> get_optimal_segment_parameter(const barrier_table&, int = AUTO_SEGMENT_MIN_LENGTH, int = AUTO_SEGMENT_MAX_LENGTH, int = 1);
 
 #endif //MSA_PROCESSTEXT_H
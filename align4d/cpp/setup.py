@@ -12,16 +12,20 @@ import platform
 if platform.system() == "Darwin":  # macOS
     os.environ["CC"] = "g++"
     os.environ["CXX"] = "g++"
-    extra_compile_args = ["-std=c++20", "-O3"]  # change to -std=c++2a if -std=c++20 is not usable
+    extra_compile_args = ["-std=c++20", "-O3", "-pthread"]  # change to -std=c++2a if -std=c++20 is not usable
+    extra_link_args = ["-pthread"]
 elif platform.system() == "Windows":  # Windows
     extra_compile_args = ["/std:c++20", "/O2"]
+    extra_link_args = []
 else:  # Linux
-    extra_compile_args = ["-std=c++20", "-O3"]  # change to -std=c++2a if -std=c++20 is not usable
+    extra_compile_args = ["-std=c++20", "-O3", "-pthread"]  # change to -std=c++2a if -std=c++20 is not usable
+    extra_link_args = ["-pthread"]
 
 module1 = Extension(
     "align4d",
-    sources=["align4d_cpython_extension.cpp", "align.cpp", "msa.cpp", "postprocess.cpp", "preprocess.cpp"],
-    extra_compile_args=extra_compile_args
+    sources=["align4d_cpython_extension.cpp", "align.cpp", "msa.cpp", "postprocess.cpp", "preprocess.cpp", "stream.cpp", "thread_pool.cpp"],
+    extra_compile_args=extra_compile_args,
+    extra_link_args=extra_link_args
 )
 
 setup(
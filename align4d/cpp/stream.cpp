@@ -0,0 +1,102 @@
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "align.h"
+#include "msa.h"
+#include "preprocess.h"
+#include "stream.h"
+
+stream_aligner::stream_aligner(int segment_length, int barrier_length, int partial_bound, const msa_config& config)
+        : segment_length(segment_length), barrier_length(barrier_length), partial_bound(partial_bound), config(config) {
+    /*
+     * @param segment_length: minimum number of hypothesis tokens between two barriers, same as get_segment_index
+     * @param barrier_length: length of the exactly matched sequence used as a barrier, same as get_segment_index
+     * @param partial_bound: upper bound (exclusive) of edit distance for two tokens to be partially matched
+     * @param config: options of the alignment engine
+     */
+    if (segment_length <= 0 || barrier_length <= 0) {
+        throw std::invalid_argument("segment length and barrier length must be positive");
+    }
+}
+
+void stream_aligner::append(const std::vector<std::string>& hypothesis_chunk, const std::vector<std::string>& reference_chunk, const std::vector<std::string>& reference_label_chunk) {
+    /*
+     * Append new tokens to the end of the hypothesis and reference
+     *
+     * @param hypothesis_chunk: new hypothesis tokens
+     * @param reference_chunk: new reference tokens
+     * @param reference_label_chunk: speaker label of each new reference token
+     */
+    if (reference_chunk.size() != reference_label_chunk.size()) {
+        throw std::invalid_argument("reference and reference label must have the same length");
+    }
+    hypothesis.insert(hypothesis.end(), hypothesis_chunk.begin(), hypothesis_chunk.end());
+    reference.insert(reference.end(), reference_chunk.begin(), reference_chunk.end());
+    reference_label.insert(reference_label.end(), reference_label_chunk.begin(), reference_label_chunk.end());
+}
+
+stream_result stream_aligner::emit() {
+    /*
+     * Align and remove the tokens before the last barrier found in the kept tokens, a barrier is a sequence of
+     * barrier_length tokens that appears in both hypothesis and reference (see get_segment_index),
+     * so the alignment before it does not depend on tokens appended later.
+     *
+     * @return: alignment of the finalized part, with empty align_result if no barrier is found
+     */
+    std::vector<std::vector<int>> segment_index = get_segment_index(hypothesis, reference, segment_length, barrier_length);
+    size_t segment_num = segment_index[0].size() - 1;
+    if (segment_num <= 1) {
+        stream_result result;
+        result.hypothesis_start = hypothesis_offset;
+        result.reference_start = reference_offset;
+        return result;
+    }
+    // the last segment ends at the end of the kept tokens, which is not confirmed yet
+    for (std::vector<int>& index: segment_index) {
+        index.pop_back();
+    }
+    return finalize(segment_index[0].back(), segment_index[1].back(), segment_index);
+}
+
+stream_result stream_aligner::flush() {
+    /*
+     * Align and remove all kept tokens, used at the end of the stream
+     *
+     * @return: alignment of all kept tokens, with empty align_result if no token is kept
+     */
+    std::vector<std::vector<int>> segment_index = get_segment_index(hypothesis, reference, segment_length, barrier_length);
+    return finalize((int)hypothesis.size(), (int)reference.size(), segment_index);
+}
+
+size_t stream_aligner::pending_hypothesis_size() const {
+    return hypothesis.size();
+}
+
+size_t stream_aligner::pending_reference_size() const {
+    return reference.size();
+}
+
+stream_result stream_aligner::finalize(int hypothesis_end, int reference_end, const std::vector<std::vector<int>>& segment_index) {
+    /*
+     * Align the kept tokens before hypothesis_end and reference_end with the segments of segment_index, then remove them
+     */
+    stream_result result;
+    result.hypothesis_start = hypothesis_offset;
+    result.reference_start = reference_offset;
+    if (hypothesis_end == 0 && reference_end == 0) {
+        return result;
+    }
+    std::vector<std::string> finalized_hypothesis(hypothesis.begin(), hypothesis.begin() + hypothesis_end);
+    std::vector<std::string> finalized_reference(reference.begin(), reference.begin() + reference_end);
+    std::vector<std::string> finalized_reference_label(reference_label.begin(), reference_label.begin() + reference_end);
+    result.speaker_label = get_unique_speaker_label(finalized_reference_label);
+    result.align_result = align_segment(finalized_hypothesis, finalized_reference, finalized_reference_label, segment_index, partial_bound, config);
+
+    hypothesis.erase(hypothesis.begin(), hypothesis.begin() + hypothesis_end);
+    reference.erase(reference.begin(), reference.begin() + reference_end);
+    reference_label.erase(reference_label.begin(), reference_label.begin() + reference_end);
+    hypothesis_offset += hypothesis_end;
+    reference_offset += reference_end;
+    return result;
+}
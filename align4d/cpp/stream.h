@@ -0,0 +1,52 @@
+#ifndef MSA_STREAM_H
+#define MSA_STREAM_H
+
+#include <string>
+#include <vector>
+
+#include "msa.h"
+#include "preprocess.h"
+
+struct stream_result {
+    /*
+     * Finalized part of a streaming alignment from stream_aligner
+     */
+    int hypothesis_start{0};    // index of the first finalized hypothesis token in the whole stream
+    int reference_start{0};     // index of the first finalized reference token in the whole stream
+    std::vector<std::string> speaker_label;                 // sorted speaker labels of the reference rows
+    std::vector<std::vector<std::string>> align_result;     // aligned hypothesis and references of each speaker, empty if nothing is finalized
+};
+
+class stream_aligner {
+    /*
+     * Incremental alignment of a hypothesis (and reference) that grows over time, such as live speech recognition output.
+     * Only the tokens after the last confirmed barrier are kept, the part before it is aligned and returned once.
+     */
+public:
+    explicit stream_aligner(int = AUTO_SEGMENT_MIN_LENGTH, int = AUTO_SEGMENT_BARRIER_LENGTH, int = 2, const msa_config& = {});
+
+    void append(const std::vector<std::string>&, const std::vector<std::string>& = {}, const std::vector<std::string>& = {});
+
+    stream_result emit();
+
+    stream_result flush();
+
+    size_t pending_hypothesis_size() const;
+
+    size_t pending_reference_size() const;
+
+private:
+    stream_result finalize(int, int, const std::vector<std::vector<int>>&);
+
+    int segment_length;
+    int barrier_length;
+    int partial_bound;
+    msa_config config;
+    std::vector<std::string> hypothesis;
+    std::vector<std::string> reference;
+    std::vector<std::string> reference_label;
+    int hypothesis_offset{0};
+    int reference_offset{0};
+};
+
+#endif //MSA_STREAM_H
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.h"
+
+thread_pool::thread_pool(int thread_num) {
+    /*
+     * Start the workers of the thread pool
+     *
+     * @param thread_num: number of workers, at least 1
+     */
+    thread_num = std::max(thread_num, 1);
+    queue.resize(thread_num);
+    for (int i = 0; i < thread_num; ++i) {
+        queue_mutex.emplace_back(std::make_unique<std::mutex>());
+    }
+    for (int i = 0; i < thread_num; ++i) {
+        worker.emplace_back(&thread_pool::work, this, i);
+    }
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    task_available.notify_all();
+    for (std::thread& thread: worker) {
+        thread.join();
+    }
+}
+
+void thread_pool::submit(std::function<void()> task) {
+    /*
+     * Add a task to the queues of workers in round-robin order
+     *
+     * @param task: function to run on a worker
+     */
+    size_t index;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        index = next_queue++ % queue.size();
+    }
+    {
+        std::lock_guard<std::mutex> lock(*queue_mutex[index]);
+        queue[index].emplace_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued_task++;
+        unfinished_task++;
+    }
+    task_available.notify_one();
+}
+
+void thread_pool::wait() {
+    /*
+     * Wait until all submitted tasks finish, rethrow the first exception thrown by any task
+     */
+    std::unique_lock<std::mutex> lock(mutex);
+    task_done.wait(lock, [this]() { return unfinished_task == 0; });
+    if (exception) {
+        std::exception_ptr task_exception = exception;
+        exception = nullptr;
+        std::rethrow_exception(task_exception);
+    }
+}
+
+bool thread_pool::pop_task(int index, std::function<void()>& task) {
+    /*
+     * Take a task from the front of the own queue, or steal one from the back of the queue of another worker
+     */
+    for (size_t i = 0; i < queue.size(); ++i) {
+        size_t victim = (index + i) % queue.size();
+        std::lock_guard<std::mutex> lock(*queue_mutex[victim]);
+        if (!queue[victim].empty()) {
+            if (i == 0) {
+                task = std::move(queue[victim].front());
+                queue[victim].pop_front();
+            } else {
+                task = std::move(queue[victim].back());
+                queue[victim].pop_back();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void thread_pool::work(int index) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            task_available.wait(lock, [this]() { return stop || queued_task > 0; });
+            if (queued_task == 0) {
+                return;
+            }
+            queued_task--; // reserve one of the queued tasks for this worker
+        }
+        std::function<void()> task;
+        while (!pop_task(index, task)) {
+            std::this_thread::yield();
+        }
+        std::exception_ptr task_exception;
+        try {
+            task();
+        } catch (...) {
+            task_exception = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (task_exception && !exception) {
+                exception = task_exception;
+            }
+            if (--unfinished_task == 0) {
+                task_done.notify_all();
+            }
+        }
+    }
+}
+
+cell_limiter::cell_limiter(size_t max_cell) : max_cell(max_cell) {}
+
+void cell_limiter::acquire(size_t cell) {
+    /*
+     * Wait until the cells can be used without exceeding the limit
+     *
+     * @param cell: number of cells needed by the task
+     */
+    std::unique_lock<std::mutex> lock(mutex);
+    cell_available.wait(lock, [&]() { return used_cell == 0 || used_cell + cell <= max_cell; });
+    used_cell += cell;
+}
+
+void cell_limiter::release(size_t cell) {
+    /*
+     * Return the cells used by a finished task
+     *
+     * @param cell: number of cells used by the task
+     */
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        used_cell -= cell;
+    }
+    cell_available.notify_all();
+}
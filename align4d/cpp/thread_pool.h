@@ -0,0 +1,66 @@
+#ifndef MSA_THREAD_POOL_H
+#define MSA_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class thread_pool {
+    /*
+     * Work-stealing thread pool, each worker has its own queue of tasks and takes tasks from the front of it,
+     * an idle worker steals tasks from the back of the queues of other workers, so tasks with very different cost
+     * are still balanced among workers.
+     */
+public:
+    explicit thread_pool(int);
+
+    ~thread_pool();
+
+    void submit(std::function<void()>);
+
+    void wait();
+
+private:
+    bool pop_task(int, std::function<void()>&);
+
+    void work(int);
+
+    std::vector<std::deque<std::function<void()>>> queue;
+    std::vector<std::unique_ptr<std::mutex>> queue_mutex;
+    std::vector<std::thread> worker;
+    std::mutex mutex;
+    std::condition_variable task_available;
+    std::condition_variable task_done;
+    std::exception_ptr exception;
+    size_t queued_task{0};
+    size_t unfinished_task{0};
+    size_t next_queue{0};
+    bool stop{false};
+};
+
+class cell_limiter {
+    /*
+     * Limit the total number of scoring matrix cells allocated by tasks running at the same time,
+     * a task larger than the limit runs only when no other task holds cells
+     */
+public:
+    explicit cell_limiter(size_t);
+
+    void acquire(size_t);
+
+    void release(size_t);
+
+private:
+    std::mutex mutex;
+    std::condition_variable cell_available;
+    size_t max_cell;
+    size_t used_cell{0};
+};
+
+#endif //MSA_THREAD_POOL_H
@@ -0,0 +1,341 @@
+/*
+ * Benchmark suite of the native alignment on seeded synthetic multi-speaker conversations, the throughput and peak memory
+ * of each benchmark are printed to stdout as JSON so that the results of different releases can be compared.
+ * To build and run this file, in the command line, change the directory to the one included in this file and type
+ * 'g++ -std=c++20 -O3 -pthread -I../align4d/cpp -Dmain=align_main -c ../align4d/cpp/align.cpp -o align.o'
+ * 'g++ -std=c++20 -O3 -pthread -I../align4d/cpp alignment_benchmark.cpp align.o ../align4d/cpp/msa.cpp ../align4d/cpp/preprocess.cpp
+ *  ../align4d/cpp/postprocess.cpp ../align4d/cpp/thread_pool.cpp -o alignment_benchmark'
+ * './alignment_benchmark [--speakers 3] [--length 1000] [--overlap 0.1] [--substitution 0.1] [--insertion 0.03] [--deletion 0.05]
+ *  [--near-miss 0.5] [--vocabulary 2000] [--msa-length 40] [--segment-length 60] [--threads 1] [--repeat 3] [--seed 42] > result.json'
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "align.h"
+#include "msa.h"
+#include "preprocess.h"
+
+struct corpus_config {
+    /*
+     * Options of the synthetic conversation, the rates are probabilities per spoken token
+     */
+    int speaker_num{3};
+    int speaker_length{1000};       // number of reference tokens of each speaker
+    double overlap_rate{0.1};       // probability that an utterance overlaps the previous one, the overlapped tokens are interleaved in the hypothesis
+    double substitution_rate{0.1};  // probability that a hypothesis token is replaced
+    double insertion_rate{0.03};    // probability that an extra token is inserted after a hypothesis token
+    double deletion_rate{0.05};     // probability that a spoken token is missing in the hypothesis
+    double near_miss_rate{0.5};     // probability that a replaced token is a near-miss spelling (one letter edited) instead of another word
+    int vocabulary_size{2000};
+    unsigned seed{42};
+};
+
+struct conversation {
+    std::vector<std::string> hypothesis;
+    std::vector<std::string> reference;
+    std::vector<std::string> reference_label;
+};
+
+struct benchmark_result {
+    std::string name;
+    double second{0};       // fastest of the repeats
+    double mean_second{0};
+    size_t cell{0};         // scoring matrix cells (or edit distance cells) of one run, 0 if not applicable
+    size_t token{0};        // input tokens of one run
+    long long checksum{0};  // summary of the output, which only changes when the result changes
+    size_t peak_rss_byte{0};
+};
+
+std::vector<std::string> get_vocabulary(int vocabulary_size, std::mt19937& rng) {
+    std::uniform_int_distribution<int> length(1, 10);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::vector<std::string> vocabulary;
+    for (int i = 0; i < vocabulary_size; ++i) {
+        std::string word;
+        for (int j = length(rng); j > 0; --j) {
+            word += (char)letter(rng);
+        }
+        vocabulary.emplace_back(word);
+    }
+    return vocabulary;
+}
+
+std::string get_near_miss(const std::string& token, std::mt19937& rng) {
+    /*
+     * Replace, insert or delete one letter of the token
+     */
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::string near_miss = token;
+    int position = (int)(rng() % near_miss.size());
+    int edit = (int)(rng() % 3);
+    if (edit == 0) {
+        near_miss[position] = (char)letter(rng);
+    } else if (edit == 1 || near_miss.size() == 1) {
+        near_miss.insert(near_miss.begin() + position, (char)letter(rng));
+    } else {
+        near_miss.erase(near_miss.begin() + position);
+    }
+    return near_miss;
+}
+
+conversation get_conversation(const corpus_config& config) {
+    /*
+     * Generate a conversation where the speakers take turns with utterances of 3 to 12 tokens until every speaker has
+     * speaker_length tokens, the words follow a Zipf distribution. The reference is the utterances in turn order,
+     * the hypothesis is the spoken tokens with recognition errors, where an overlapping utterance is interleaved with the previous one.
+     */
+    std::mt19937 rng(config.seed);
+    std::vector<std::string> vocabulary = get_vocabulary(config.vocabulary_size, rng);
+    std::vector<double> weight(vocabulary.size());
+    for (int i = 0; i < weight.size(); ++i) {
+        weight[i] = 1.0 / (i + 1);
+    }
+    std::discrete_distribution<int> word(weight.begin(), weight.end());
+    std::uniform_real_distribution<double> probability(0, 1);
+
+    conversation result;
+    std::vector<std::string> spoken;
+    std::vector<int> remaining(config.speaker_num, config.speaker_length);
+    int previous_speaker{-1}, previous_length{0};
+    while (true) {
+        std::vector<int> candidate;
+        for (int speaker = 0; speaker < config.speaker_num; ++speaker) {
+            if (remaining[speaker] > 0 && (speaker != previous_speaker || config.speaker_num == 1)) {
+                candidate.emplace_back(speaker);
+            }
+        }
+        if (candidate.empty() && previous_speaker != -1 && remaining[previous_speaker] > 0) {
+            candidate.emplace_back(previous_speaker);
+        }
+        if (candidate.empty()) {
+            break;
+        }
+        int speaker = candidate[rng() % candidate.size()];
+        int length = std::min(remaining[speaker], 3 + (int)(rng() % 10));
+        remaining[speaker] -= length;
+        std::vector<std::string> utterance;
+        for (int i = 0; i < length; ++i) {
+            utterance.emplace_back(vocabulary[word(rng)]);
+            result.reference.emplace_back(utterance.back());
+            result.reference_label.emplace_back("speaker" + std::to_string(speaker));
+        }
+        if (previous_length > 0 && probability(rng) < config.overlap_rate) {
+            // interleave with the tokens of the previous utterance, keeping the order of each utterance
+            std::vector<std::string> previous(spoken.end() - previous_length, spoken.end());
+            spoken.resize(spoken.size() - previous_length);
+            size_t i = 0, j = 0;
+            while (i < previous.size() || j < utterance.size()) {
+                bool take_previous = j == utterance.size() || (i < previous.size() && rng() % 2 == 0);
+                spoken.emplace_back(take_previous ? previous[i++] : utterance[j++]);
+            }
+            previous_length += length;
+        } else {
+            spoken.insert(spoken.end(), utterance.begin(), utterance.end());
+            previous_length = length;
+        }
+        previous_speaker = speaker;
+    }
+
+    for (const std::string& token: spoken) {
+        double roll = probability(rng);
+        if (roll < config.deletion_rate) {
+            continue;
+        }
+        if (roll < config.deletion_rate + config.substitution_rate) {
+            result.hypothesis.emplace_back(probability(rng) < config.near_miss_rate ? get_near_miss(token, rng) : vocabulary[word(rng)]);
+        } else {
+            result.hypothesis.emplace_back(token);
+        }
+        if (probability(rng) < config.insertion_rate) {
+            result.hypothesis.emplace_back(vocabulary[word(rng)]);
+        }
+    }
+    return result;
+}
+
+size_t get_peak_rss_byte() {
+    /*
+     * Peak resident set size of the process so far
+     */
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counter;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counter, sizeof(counter));
+    return counter.PeakWorkingSetSize;
+#else
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss;
+#else
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+benchmark_result run_benchmark(const std::string& name, int repeat, size_t cell, size_t token, const std::function<long long()>& f) {
+    benchmark_result result{name};
+    result.second = 1e300;
+    for (int r = 0; r < repeat; ++r) {
+        auto start = std::chrono::high_resolution_clock::now();
+        result.checksum = f();
+        auto end = std::chrono::high_resolution_clock::now();
+        double second = std::chrono::duration<double>(end - start).count();
+        result.second = std::min(result.second, second);
+        result.mean_second += second / repeat;
+    }
+    result.cell = cell;
+    result.token = token;
+    result.peak_rss_byte = get_peak_rss_byte();
+    std::cerr << name << ": " << result.second << " s" << std::endl;
+    return result;
+}
+
+long long get_checksum(const std::vector<std::vector<std::string>>& align_result) {
+    long long checksum{0};
+    for (const std::vector<std::string>& sequence: align_result) {
+        for (const std::string& token: sequence) {
+            checksum = checksum * 31 + (token == GAP ? 1 : (long long)token.size() + 2);
+        }
+    }
+    return checksum;
+}
+
+std::string get_json_throughput(size_t count, double second) {
+    return count == 0 ? "null" : std::to_string(count / second);
+}
+
+int main(int argc, char **argv) {
+    corpus_config corpus;
+    int msa_length{40}, segment_length{60}, thread_num{1}, repeat{3};
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        const char *value = argv[i + 1];
+        if (option == "--speakers") corpus.speaker_num = std::atoi(value);
+        else if (option == "--length") corpus.speaker_length = std::atoi(value);
+        else if (option == "--overlap") corpus.overlap_rate = std::atof(value);
+        else if (option == "--substitution") corpus.substitution_rate = std::atof(value);
+        else if (option == "--insertion") corpus.insertion_rate = std::atof(value);
+        else if (option == "--deletion") corpus.deletion_rate = std::atof(value);
+        else if (option == "--near-miss") corpus.near_miss_rate = std::atof(value);
+        else if (option == "--vocabulary") corpus.vocabulary_size = std::atoi(value);
+        else if (option == "--msa-length") msa_length = std::atoi(value);
+        else if (option == "--segment-length") segment_length = std::atoi(value);
+        else if (option == "--threads") thread_num = std::atoi(value);
+        else if (option == "--repeat") repeat = std::max(1, std::atoi(value));
+        else if (option == "--seed") corpus.seed = (unsigned)std::atoll(value);
+        else {
+            std::cerr << "unknown option: " << option << std::endl;
+            return 1;
+        }
+    }
+    msa_config config;
+    config.thread_num = thread_num;
+    conversation dialogue = get_conversation(corpus);
+    size_t dialogue_token = dialogue.hypothesis.size() + dialogue.reference.size();
+    std::vector<benchmark_result> result_list;
+
+    // edit distance of hypothesis tokens and random reference tokens, the cells are the product of the token lengths
+    {
+        std::mt19937 rng(corpus.seed);
+        std::vector<std::pair<std::string_view, std::string_view>> token_pair;
+        size_t cell{0};
+        for (int i = 0; i < 200000 && !dialogue.hypothesis.empty(); ++i) {
+            token_pair.emplace_back(dialogue.hypothesis[i % dialogue.hypothesis.size()], dialogue.reference[rng() % dialogue.reference.size()]);
+            cell += token_pair.back().first.size() * token_pair.back().second.size();
+        }
+        result_list.emplace_back(run_benchmark("edit_distance", repeat, cell, 2 * token_pair.size(), [&]() {
+            long long checksum{0};
+            for (const auto& [token1, token2]: token_pair) {
+                checksum += edit_distance(token1, token2);
+            }
+            return checksum;
+        }));
+    }
+
+    // a single unsegmented alignment of a short conversation of the same speakers
+    {
+        corpus_config short_corpus = corpus;
+        short_corpus.speaker_length = msa_length;
+        conversation short_dialogue = get_conversation(short_corpus);
+        std::vector<std::vector<std::string>> separated_reference = get_separate_sequence(short_dialogue.reference, short_dialogue.reference_label);
+        size_t cell = short_dialogue.hypothesis.size() + 1;
+        for (const std::vector<std::string>& sequence: separated_reference) {
+            cell *= sequence.size() + 1;
+        }
+        result_list.emplace_back(run_benchmark("multi_sequence_alignment", repeat, cell, short_dialogue.hypothesis.size() + short_dialogue.reference.size(), [&]() {
+            return get_checksum(multi_sequence_alignment(short_dialogue.hypothesis, separated_reference, 2, config));
+        }));
+
+        // the same alignment with the A* engine, which only reaches part of the cells
+        msa_config astar_config = config;
+        astar_config.engine = msa_engine::astar;
+        result_list.emplace_back(run_benchmark("astar_alignment", repeat, cell, short_dialogue.hypothesis.size() + short_dialogue.reference.size(), [&]() {
+            return get_checksum(multi_sequence_alignment(short_dialogue.hypothesis, separated_reference, 2, astar_config));
+        }));
+
+        // the same alignment with the approximate progressive engine, the cells are those of the pairwise alignments
+        msa_config progressive_config = config;
+        progressive_config.engine = msa_engine::progressive;
+        size_t pair_cell{0};
+        for (const std::vector<std::string>& sequence: separated_reference) {
+            pair_cell += (short_dialogue.hypothesis.size() + 1) * (sequence.size() + 1);
+        }
+        result_list.emplace_back(run_benchmark("progressive_alignment", repeat, pair_cell, short_dialogue.hypothesis.size() + short_dialogue.reference.size(), [&]() {
+            return get_checksum(multi_sequence_alignment(short_dialogue.hypothesis, separated_reference, 2, progressive_config));
+        }));
+    }
+
+    result_list.emplace_back(run_benchmark("get_segment_index", repeat, 0, dialogue_token, [&]() {
+        return (long long)get_segment_index(dialogue.hypothesis, dialogue.reference, segment_length, AUTO_SEGMENT_BARRIER_LENGTH)[0].size();
+    }));
+
+    result_list.emplace_back(run_benchmark("get_optimal_segment_parameter", repeat, 0, dialogue_token, [&]() {
+        auto [optimal_segment_length, optimal_barrier_length] = get_optimal_segment_parameter(dialogue.hypothesis, dialogue.reference, AUTO_SEGMENT_MIN_LENGTH,
+                                                                                              AUTO_SEGMENT_MAX_LENGTH, AUTO_SEGMENT_BARRIER_LENGTH, thread_num);
+        return (long long)optimal_segment_length * 1000 + optimal_barrier_length;
+    }));
+
+    // end-to-end alignment, the cells are the scoring matrix cells of all segments predicted with the same segmentation
+    {
+        size_t cell{0};
+        for (const segment_cost& cost: estimate_alignment_cost(dialogue.hypothesis, dialogue.reference, dialogue.reference_label, SEGMENT_AUTO, SEGMENT_AUTO, config)) {
+            cell += cost.cost.cell;
+        }
+        result_list.emplace_back(run_benchmark("align_with_auto_segment", repeat, cell, dialogue_token, [&]() {
+            return get_checksum(align_with_auto_segment(dialogue.hypothesis, dialogue.reference, dialogue.reference_label, 2, config));
+        }));
+    }
+
+    std::cout << "{\n  \"corpus\": {\"speaker_num\": " << corpus.speaker_num << ", \"speaker_length\": " << corpus.speaker_length
+              << ", \"overlap_rate\": " << corpus.overlap_rate << ", \"substitution_rate\": " << corpus.substitution_rate
+              << ", \"insertion_rate\": " << corpus.insertion_rate << ", \"deletion_rate\": " << corpus.deletion_rate
+              << ", \"near_miss_rate\": " << corpus.near_miss_rate << ", \"vocabulary_size\": " << corpus.vocabulary_size << ", \"seed\": " << corpus.seed
+              << ", \"hypothesis_length\": " << dialogue.hypothesis.size() << ", \"reference_length\": " << dialogue.reference.size() << "},\n"
+              << "  \"msa_length\": " << msa_length << ", \"segment_length\": " << segment_length << ", \"thread_num\": " << thread_num
+              << ", \"repeat\": " << repeat << ",\n  \"benchmark\": [\n";
+    for (int i = 0; i < result_list.size(); ++i) {
+        const benchmark_result& result = result_list[i];
+        std::cout << "    {\"name\": \"" << result.name << "\", \"second\": " << result.second << ", \"mean_second\": " << result.mean_second
+                  << ", \"cell\": " << result.cell << ", \"token\": " << result.token
+                  << ", \"cell_per_second\": " << get_json_throughput(result.cell, result.second)
+                  << ", \"token_per_second\": " << get_json_throughput(result.token, result.second)
+                  << ", \"checksum\": " << result.checksum << ", \"peak_rss_byte\": " << result.peak_rss_byte << "}"
+                  << (i + 1 < result_list.size() ? ",\n" : "\n");
+    }
+    std::cout << "  ],\n  \"peak_rss_byte\": " << get_peak_rss_byte() << "\n}" << std::endl;
+    return 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * Micro-benchmark comparing the full Levenshtein Distance (edit_distance) with the bound-aware kernel (edit_distance_below).
+ * To build and run this file, in the command line, change the directory to the one included in this file and type
+ * 'g++ -std=c++20 -O3 -I../align4d/cpp edit_distance_benchmark.cpp ../align4d/cpp/msa.cpp -o edit_distance_benchmark'
+ * './edit_distance_benchmark'
+ */
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "msa.h"
+
+std::vector<std::pair<std::string, std::string>> get_token_pair(int pair_num, int min_length, int max_length, unsigned seed) {
+    /*
+     * Generate pairs of tokens where half of them are near-miss spellings of each other
+     */
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> length(min_length, max_length);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::vector<std::pair<std::string, std::string>> token_pair;
+    for (int i = 0; i < pair_num; ++i) {
+        std::string token1, token2;
+        for (int j = length(rng); j > 0; --j) {
+            token1 += (char)letter(rng);
+        }
+        if (i % 2 == 0) {
+            token2 = token1;
+            for (int j = (int)(rng() % 3); j > 0 && !token2.empty(); --j) {
+                token2[rng() % token2.size()] = (char)letter(rng);
+            }
+        } else {
+            for (int j = length(rng); j > 0; --j) {
+                token2 += (char)letter(rng);
+            }
+        }
+        token_pair.emplace_back(token1, token2);
+    }
+    return token_pair;
+}
+
+template <typename F> double time_per_pair(const std::vector<std::pair<std::string, std::string>>& token_pair, int repeat, F f, long long& checksum) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < repeat; ++r) {
+        for (const auto& [token1, token2]: token_pair) {
+            checksum += f(token1, token2);
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ((double)repeat * token_pair.size());
+}
+
+int main() {
+    const int partial_bound{2};
+    struct { const char* name; int min_length; int max_length; int repeat; } workload[] = {
+            {"word (1-12 chars)", 1, 12, 50},
+            {"long word (13-64 chars)", 13, 64, 10},
+            {"very long token (65-200 chars)", 65, 200, 2},
+    };
+    for (const auto& [name, min_length, max_length, repeat]: workload) {
+        auto token_pair = get_token_pair(20000, min_length, max_length, 42);
+        long long full_checksum{0}, bounded_checksum{0};
+        double full = time_per_pair(token_pair, repeat, [&](const std::string& a, const std::string& b) { return edit_distance(a, b) < partial_bound; }, full_checksum);
+        double bounded = time_per_pair(token_pair, repeat, [&](const std::string& a, const std::string& b) { return edit_distance_below(a, b, partial_bound); }, bounded_checksum);
+        std::cout << name << ": edit_distance " << full << " ns/pair, edit_distance_below " << bounded << " ns/pair, speedup "
+                  << full / bounded << "x" << (full_checksum == bounded_checksum ? "" : " (RESULT MISMATCH)") << std::endl;
+    }
+    return 0;
+}
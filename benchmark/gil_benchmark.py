@@ -0,0 +1,67 @@
+"""
+Multi-threaded throughput benchmark of align4d.align().
+The native alignment runs with the GIL released, so aligning independent conversations from a ThreadPoolExecutor
+should scale with the number of threads instead of running one conversation at a time.
+To run this file, install align4d (or put the compiled package on PYTHONPATH) and type
+'python gil_benchmark.py [conversation_num] [hypothesis_length] [max_thread_num]'
+"""
+import random
+import sys
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+from align4d import align
+
+
+def get_conversation(hypothesis_length: int, speaker_num: int, seed: int) -> tuple:
+    """
+    Generate a random conversation where the hypothesis is the speaker turns joined with some recognition errors.
+    """
+    rng = random.Random(seed)
+    vocabulary = [f"word{i}" for i in range(200)]
+    reference = []
+    hypothesis = []
+    while len(hypothesis) < hypothesis_length:
+        utterance = [rng.choice(vocabulary) for _ in range(rng.randint(3, 12))]
+        reference.append([f"speaker{rng.randrange(speaker_num)}", " ".join(utterance)])
+        for token in utterance:
+            roll = rng.random()
+            if roll < 0.05:
+                continue
+            hypothesis.append(rng.choice(vocabulary) if roll < 0.15 else token)
+    return hypothesis, reference
+
+
+def run(conversation: list[tuple], thread_num: int) -> float:
+    """
+    Align all conversations with the given number of python threads and return the elapsed seconds.
+    """
+    start = time.perf_counter()
+    if thread_num == 1:
+        for hypothesis, reference in conversation:
+            align.align(hypothesis, reference)
+    else:
+        with ThreadPoolExecutor(max_workers=thread_num) as executor:
+            list(executor.map(lambda job: align.align(job[0], job[1]), conversation))
+    return time.perf_counter() - start
+
+
+def main():
+    conversation_num = int(sys.argv[1]) if len(sys.argv) > 1 else 16
+    hypothesis_length = int(sys.argv[2]) if len(sys.argv) > 2 else 600
+    max_thread_num = int(sys.argv[3]) if len(sys.argv) > 3 else 8
+    conversation = [get_conversation(hypothesis_length, 2, seed) for seed in range(conversation_num)]
+
+    print(f"{conversation_num} conversations, {hypothesis_length} hypothesis tokens each")
+    print(f"{'threads':>8} {'seconds':>10} {'conv/s':>10} {'speedup':>8}")
+    serial_second = None
+    thread_num = 1
+    while thread_num <= max_thread_num:
+        second = run(conversation, thread_num)
+        serial_second = serial_second or second
+        print(f"{thread_num:>8} {second:>10.3f} {conversation_num / second:>10.2f} {serial_second / second:>8.2f}")
+        thread_num *= 2
+
+
+if __name__ == "__main__":
+    main()